@@ -26,6 +26,7 @@
 #include "wupsxx/color_item.hpp"
 #include "wupsxx/storage.hpp"
 #include "wupsxx/duration_items.hpp"
+#include "wupsxx/int_item.hpp"
 
 #ifdef HAVE_CONFIG_H
 #include <config.h>
@@ -42,63 +43,126 @@ namespace cfg {
 
 
     namespace labels {
-        const char* button_rate      = "Button press rate";
-        const char* color_bg         = "Background color";
-        const char* color_fg         = "Foreground color";
-        const char* cpu_busy         = "CPU utilization";
-        const char* cpu_busy_percent = " └ Show percentage";
-        const char* enabled          = "Enabled";
-        const char* fs_read          = "Filesystem";
-        const char* gpu_busy         = "GPU utilization";
-        const char* gpu_busy_percent = " └ Show percentage";
-        const char* gpu_fps          = "Frames per second";
-        const char* interval         = "Update interval";
-        const char* net_bw           = "Network bandwidth";
-        const char* net_cfg          = "Network configuration";
-        const char* time             = "Time";
-        const char* time_24h         = " └ Format";
-        const char* toggle_shortcut  = " └ Toggle shortcut";
+        const char* button_rate        = "Button press rate";
+        const char* color_bg           = "Background color";
+        const char* color_fg           = "Foreground color";
+        const char* cpu_busy           = "CPU utilization";
+        const char* cpu_busy_percent   = " └ Show percentage";
+        const char* enabled            = "Enabled";
+        const char* fs_devices         = " └ Per device";
+        const char* fs_hot             = " └ Most read files";
+        const char* fs_io              = "Filesystem I/O latency";
+        const char* fs_read            = "Filesystem";
+        const char* fs_trace           = " └ Record I/O trace";
+        const char* gpu_bandwidth      = "GPU memory bandwidth";
+        const char* gpu_bottleneck     = "Bottleneck";
+        const char* gpu_busy           = "GPU utilization";
+        const char* gpu_busy_ab_test   = " └ A/B test readback";
+        const char* gpu_busy_percent   = " └ Show percentage";
+        const char* gpu_busy_pipelined = " └ Pipelined readback";
+        const char* gpu_draws          = "Draw calls";
+        const char* gpu_fps            = "Frames per second";
+        const char* gpu_fps_lows       = " └ Show 1% and 0.1% lows";
+        const char* gpu_passes         = "GPU render passes";
+        const char* gpu_present        = "Presentation (flips)";
+        const char* gpu_sample_period  = " └ Sample 1 of N frames (0 = auto)";
+        const char* gpu_stages         = "GPU stage utilization";
+        const char* gpu_stalls         = "CPU stalls on the GPU";
+        const char* gpu_targets        = "TV and GamePad frame rates";
+        const char* gpu_time           = "GPU frame time";
+        const char* gpu_vram           = "GPU memory usage";
+        const char* interval           = "Update interval";
+        const char* native_overlay     = "Renderer";
+        const char* net_bw             = "Network bandwidth";
+        const char* net_cfg            = "Network configuration";
+        const char* swap_wait          = "CPU work / swap wait";
+        const char* threaded_update    = "Update from a thread";
+        const char* time               = "Time";
+        const char* time_24h           = " └ Format";
+        const char* toggle_shortcut    = " └ Toggle shortcut";
     }
 
 
     namespace defaults {
-        const bool         button_rate      = true;
-        const color        color_bg         = {0x00, 0x00, 0x00, 0xc0};
-        const color        color_fg         = {0x60, 0xff, 0x60};
-        const bool         cpu_busy         = true;
-        const bool         cpu_busy_percent = false;
-        const bool         enabled          = true;
-        const bool         fs_read          = true;
-        const bool         gpu_busy         = true;
-        const bool         gpu_busy_percent = false;
-        const bool         gpu_fps          = true;
-        const milliseconds interval         = 1000ms;
-        const bool         net_bw           = true;
-        const bool         net_cfg          = true;
-        const bool         time             = true;
-        const bool         time_24h         = true;
-        const button_combo toggle_shortcut  = wups::utils::vpad::button_set{
+        const bool         button_rate        = true;
+        const color        color_bg           = {0x00, 0x00, 0x00, 0xc0};
+        const color        color_fg           = {0x60, 0xff, 0x60};
+        const bool         cpu_busy           = true;
+        const bool         cpu_busy_percent   = false;
+        const bool         enabled            = true;
+        const bool         fs_devices         = false;
+        const bool         fs_hot             = false;
+        const bool         fs_io              = false;
+        const bool         fs_read            = true;
+        const bool         fs_trace           = false;
+        const bool         gpu_bandwidth      = false;
+        const bool         gpu_bottleneck     = false;
+        const bool         gpu_busy           = false;
+        const bool         gpu_busy_ab_test   = false;
+        const bool         gpu_busy_percent   = false;
+        const bool         gpu_busy_pipelined = true;
+        const bool         gpu_draws          = false;
+        const bool         gpu_fps            = true;
+        const bool         gpu_fps_lows       = true;
+        const bool         gpu_passes         = false;
+        const bool         gpu_present        = false;
+        const int          gpu_sample_period  = 0;
+        const bool         gpu_stages         = false;
+        const bool         gpu_stalls         = false;
+        const bool         gpu_targets        = false;
+        const bool         gpu_time           = true;
+        const bool         gpu_vram           = false;
+        const milliseconds interval           = 1000ms;
+        const bool         native_overlay     = false;
+        const bool         net_bw             = true;
+        const bool         net_cfg            = true;
+        const bool         swap_wait          = false;
+        const bool         threaded_update    = true;
+        const bool         time               = true;
+        const bool         time_24h           = true;
+        const button_combo toggle_shortcut    = wups::utils::vpad::button_set{
             VPAD_BUTTON_TV, VPAD_BUTTON_LEFT
         };
     }
 
 
-    bool         button_rate      = defaults::button_rate;
-    color        color_bg         = defaults::color_bg;
-    color        color_fg         = defaults::color_fg;
-    bool         cpu_busy         = defaults::cpu_busy;
-    bool         cpu_busy_percent = defaults::cpu_busy_percent;
-    bool         enabled          = defaults::enabled;
-    bool         fs_read          = defaults::fs_read;
-    bool         gpu_busy         = defaults::gpu_busy;
-    bool         gpu_busy_percent = defaults::gpu_busy_percent;
-    bool         gpu_fps          = defaults::gpu_fps;
-    milliseconds interval         = defaults::interval;
-    bool         net_bw           = defaults::net_bw;
-    bool         net_cfg          = defaults::net_cfg;
-    bool         time             = defaults::time;
-    bool         time_24h         = defaults::time_24h;
-    button_combo  toggle_shortcut = defaults::toggle_shortcut;
+    bool         button_rate        = defaults::button_rate;
+    color        color_bg           = defaults::color_bg;
+    color        color_fg           = defaults::color_fg;
+    bool         cpu_busy           = defaults::cpu_busy;
+    bool         cpu_busy_percent   = defaults::cpu_busy_percent;
+    bool         enabled            = defaults::enabled;
+    bool         fs_devices         = defaults::fs_devices;
+    bool         fs_hot             = defaults::fs_hot;
+    bool         fs_io              = defaults::fs_io;
+    bool         fs_read            = defaults::fs_read;
+    bool         fs_trace           = defaults::fs_trace;
+    bool         gpu_bandwidth      = defaults::gpu_bandwidth;
+    bool         gpu_bottleneck     = defaults::gpu_bottleneck;
+    bool         gpu_busy           = defaults::gpu_busy;
+    bool         gpu_busy_ab_test   = defaults::gpu_busy_ab_test;
+    bool         gpu_busy_percent   = defaults::gpu_busy_percent;
+    bool         gpu_busy_pipelined = defaults::gpu_busy_pipelined;
+    bool         gpu_draws          = defaults::gpu_draws;
+    bool         gpu_fps            = defaults::gpu_fps;
+    bool         gpu_fps_lows       = defaults::gpu_fps_lows;
+    bool         gpu_passes         = defaults::gpu_passes;
+    bool         gpu_present        = defaults::gpu_present;
+    int          gpu_sample_period  = defaults::gpu_sample_period;
+    bool         gpu_stages         = defaults::gpu_stages;
+    bool         gpu_stalls         = defaults::gpu_stalls;
+    bool         gpu_targets        = defaults::gpu_targets;
+    bool         gpu_time           = defaults::gpu_time;
+    bool         gpu_vram           = defaults::gpu_vram;
+    milliseconds interval           = defaults::interval;
+    bool         native_overlay     = defaults::native_overlay;
+    bool         net_bw             = defaults::net_bw;
+    bool         net_cfg            = defaults::net_cfg;
+    bool         swap_wait          = defaults::swap_wait;
+    bool         threaded_update    = defaults::threaded_update;
+    bool         time               = defaults::time;
+    bool         time_24h           = defaults::time_24h;
+    button_combo toggle_shortcut    = defaults::toggle_shortcut;
 
 
     WUPSConfigAPICallbackStatus
@@ -115,6 +179,16 @@ namespace cfg {
                                                          toggle_shortcut,
                                                          defaults::toggle_shortcut));
 
+        root.add(wups::config::bool_item::create(labels::native_overlay,
+                                                 native_overlay,
+                                                 defaults::native_overlay,
+                                                 "native", "notification"));
+
+        root.add(wups::config::bool_item::create(labels::threaded_update,
+                                                 threaded_update,
+                                                 defaults::threaded_update,
+                                                 "yes", "no"));
+
         root.add(wups::config::bool_item::create(labels::time,
                                                  time,
                                                  defaults::time,
@@ -130,6 +204,26 @@ namespace cfg {
                                                  defaults::gpu_fps,
                                                  "on", "off"));
 
+        root.add(wups::config::bool_item::create(labels::gpu_fps_lows,
+                                                 gpu_fps_lows,
+                                                 defaults::gpu_fps_lows,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_targets,
+                                                 gpu_targets,
+                                                 defaults::gpu_targets,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_present,
+                                                 gpu_present,
+                                                 defaults::gpu_present,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_time,
+                                                 gpu_time,
+                                                 defaults::gpu_time,
+                                                 "on", "off"));
+
         root.add(wups::config::bool_item::create(labels::gpu_busy,
                                                  gpu_busy,
                                                  defaults::gpu_busy,
@@ -140,6 +234,61 @@ namespace cfg {
                                                  defaults::gpu_busy_percent,
                                                  "on", "off"));
 
+        root.add(wups::config::bool_item::create(labels::gpu_busy_pipelined,
+                                                 gpu_busy_pipelined,
+                                                 defaults::gpu_busy_pipelined,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_busy_ab_test,
+                                                 gpu_busy_ab_test,
+                                                 defaults::gpu_busy_ab_test,
+                                                 "on", "off"));
+
+        root.add(wups::config::int_item::create(labels::gpu_sample_period,
+                                                gpu_sample_period,
+                                                defaults::gpu_sample_period,
+                                                0, 60));
+
+        root.add(wups::config::bool_item::create(labels::gpu_bandwidth,
+                                                 gpu_bandwidth,
+                                                 defaults::gpu_bandwidth,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_stages,
+                                                 gpu_stages,
+                                                 defaults::gpu_stages,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_passes,
+                                                 gpu_passes,
+                                                 defaults::gpu_passes,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_bottleneck,
+                                                 gpu_bottleneck,
+                                                 defaults::gpu_bottleneck,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::swap_wait,
+                                                 swap_wait,
+                                                 defaults::swap_wait,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_stalls,
+                                                 gpu_stalls,
+                                                 defaults::gpu_stalls,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_draws,
+                                                 gpu_draws,
+                                                 defaults::gpu_draws,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::gpu_vram,
+                                                 gpu_vram,
+                                                 defaults::gpu_vram,
+                                                 "on", "off"));
+
         root.add(wups::config::bool_item::create(labels::cpu_busy,
                                                  cpu_busy,
                                                  defaults::cpu_busy,
@@ -165,6 +314,26 @@ namespace cfg {
                                                  defaults::fs_read,
                                                  "on", "off"));
 
+        root.add(wups::config::bool_item::create(labels::fs_devices,
+                                                 fs_devices,
+                                                 defaults::fs_devices,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::fs_hot,
+                                                 fs_hot,
+                                                 defaults::fs_hot,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::fs_io,
+                                                 fs_io,
+                                                 defaults::fs_io,
+                                                 "on", "off"));
+
+        root.add(wups::config::bool_item::create(labels::fs_trace,
+                                                 fs_trace,
+                                                 defaults::fs_trace,
+                                                 "on", "off"));
+
         root.add(wups::config::bool_item::create(labels::button_rate,
                                                  button_rate,
                                                  defaults::button_rate,
@@ -201,7 +370,7 @@ namespace cfg {
         if (enabled)
             overlay::create_or_reset();
         else
-            overlay::destroy();
+            overlay::hide();
     }
 
 
@@ -234,13 +403,34 @@ namespace cfg {
             LOAD(cpu_busy);
             LOAD(cpu_busy_percent);
             LOAD(enabled);
+            LOAD(fs_devices);
+            LOAD(fs_hot);
+            LOAD(fs_io);
             LOAD(fs_read);
+            LOAD(fs_trace);
+            LOAD(gpu_bandwidth);
+            LOAD(gpu_bottleneck);
             LOAD(gpu_busy);
+            LOAD(gpu_busy_ab_test);
             LOAD(gpu_busy_percent);
+            LOAD(gpu_busy_pipelined);
+            LOAD(gpu_draws);
             LOAD(gpu_fps);
+            LOAD(gpu_fps_lows);
+            LOAD(gpu_passes);
+            LOAD(gpu_present);
+            LOAD(gpu_sample_period);
+            LOAD(gpu_stages);
+            LOAD(gpu_stalls);
+            LOAD(gpu_targets);
+            LOAD(gpu_time);
+            LOAD(gpu_vram);
             LOAD(interval);
+            LOAD(native_overlay);
             LOAD(net_bw);
             LOAD(net_cfg);
+            LOAD(swap_wait);
+            LOAD(threaded_update);
             LOAD(time);
             LOAD(time_24h);
             LOAD(toggle_shortcut);
@@ -263,13 +453,34 @@ namespace cfg {
             STORE(cpu_busy);
             STORE(cpu_busy_percent);
             STORE(enabled);
+            STORE(fs_devices);
+            STORE(fs_hot);
+            STORE(fs_io);
             STORE(fs_read);
+            STORE(fs_trace);
+            STORE(gpu_bandwidth);
+            STORE(gpu_bottleneck);
             STORE(gpu_busy);
+            STORE(gpu_busy_ab_test);
             STORE(gpu_busy_percent);
+            STORE(gpu_busy_pipelined);
+            STORE(gpu_draws);
             STORE(gpu_fps);
+            STORE(gpu_fps_lows);
+            STORE(gpu_passes);
+            STORE(gpu_present);
+            STORE(gpu_sample_period);
+            STORE(gpu_stages);
+            STORE(gpu_stalls);
+            STORE(gpu_targets);
+            STORE(gpu_time);
+            STORE(gpu_vram);
             STORE(interval);
+            STORE(native_overlay);
             STORE(net_bw);
             STORE(net_cfg);
+            STORE(swap_wait);
+            STORE(threaded_update);
             STORE(time);
             STORE(time_24h);
             STORE(toggle_shortcut);
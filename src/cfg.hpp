@@ -23,13 +23,34 @@ namespace cfg {
     extern bool                      cpu_busy;
     extern bool                      cpu_busy_percent;
     extern bool                      enabled;
+    extern bool                      fs_devices;
+    extern bool                      fs_hot;
+    extern bool                      fs_io;
     extern bool                      fs_read;
+    extern bool                      fs_trace;
+    extern bool                      gpu_bandwidth;
+    extern bool                      gpu_bottleneck;
     extern bool                      gpu_busy;
+    extern bool                      gpu_busy_ab_test;
     extern bool                      gpu_busy_percent;
+    extern bool                      gpu_busy_pipelined;
+    extern bool                      gpu_draws;
     extern bool                      gpu_fps;
+    extern bool                      gpu_fps_lows;
+    extern bool                      gpu_passes;
+    extern bool                      gpu_present;
+    extern int                       gpu_sample_period;
+    extern bool                      gpu_stages;
+    extern bool                      gpu_stalls;
+    extern bool                      gpu_targets;
+    extern bool                      gpu_time;
+    extern bool                      gpu_vram;
     extern std::chrono::milliseconds interval;
+    extern bool                      native_overlay;
     extern bool                      net_bw;
     extern bool                      net_cfg;
+    extern bool                      swap_wait;
+    extern bool                      threaded_update;
     extern bool                      time;
     extern bool                      time_24h;
     extern wups::utils::button_combo toggle_shortcut;
@@ -44,6 +44,22 @@ namespace cpu_mon {
     }
 
 
+    unsigned
+    get_least_busy_core()
+    {
+        unsigned best = 0;
+        float best_util = get_core_utilization(0);
+        for (unsigned core = 1; core < 3; ++core) {
+            float util = get_core_utilization(core);
+            if (util < best_util) {
+                best = core;
+                best_util = util;
+            }
+        }
+        return best;
+    }
+
+
     void
     initialize()
     {}
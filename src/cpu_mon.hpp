@@ -16,6 +16,8 @@ namespace cpu_mon {
     void reset();
     const char* get_report(float dt);
 
+    unsigned get_least_busy_core();
+
 }
 
 #endif
@@ -20,23 +20,577 @@
  * Note that we can't really track I/O that happens under the apps (e.g. kernel, IOSU). If
  * you try moving a game between NAND and USB from the system settings, this code can't
  * see the I/O happening.
+ *
+ * Every request is timestamped when submitted, and its latency goes into a histogram for
+ * its kind (read, write, open, stat) when it completes. Async requests can complete in
+ * callback context, so nothing here takes a regular lock: the histograms and counters
+ * are all atomic, and the handle tables use an uninterruptible spinlock.
+ *
+ * While the per-device or hot file stats are shown, each file (or raw device) handle is
+ * mapped to the device that backs it, from the path it was opened with, so reads and
+ * writes can be counted per device. Each core caches its last file lookup, so a stream
+ * of reads from one file doesn't take the tables' lock every time. File paths are also
+ * interned, and the bytes read from each go into a Space-Saving sketch, to find the files
+ * that are read the most.
+ *
+ * Optionally, every request is also recorded into a binary trace on the SD card, to be
+ * analyzed offline (see io_trace.hpp, and tools/).
  */
 
+#include <algorithm>           // min()
+#include <array>
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
-#include <new>
+#include <cstdlib>             // aligned_alloc(), free()
+#include <cstring>             // strnlen(), strrchr()
+#include <optional>
+#include <string_view>
 
+#include <coreinit/core.h>      // OSGetCoreId()
 #include <coreinit/filesystem_fsa.h>
+#include <coreinit/mcp.h>
+#include <coreinit/spinlock.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+#include <coreinit/title.h>     // OSGetTitleID()
+#include <sys/stat.h>           // mkdir()
 
 #include <wups.h>
 
 #include "fs_mon.hpp"
 
+#include "cfg.hpp"
+#include "io_trace.hpp"
+#include "log_histogram.hpp"
+#include "logger.hpp"
+#include "object_pool.hpp"
+#include "ptr_map.hpp"
+#include "sharded_counter.hpp"
+#include "space_saving.hpp"
+#include "string_arena.hpp"
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+using namespace std::literals;
+
 
 namespace fs_mon {
 
-    std::atomic_uint bytes_read = 0;
+    utils::sharded_counter<> bytes_read;
+    utils::sharded_counter<> bytes_written;
+
+
+    enum op_kind : unsigned {
+        op_read,
+        op_write,
+        op_open,
+        op_stat,
+        op_other,
+        num_ops
+    };
+
+    const char* const op_labels[num_ops] = {
+        "rd",
+        "wr",
+        "open",
+        "stat",
+        "other",
+    };
+
+    // Completion latency of each kind of request, in microseconds.
+    std::array<utils::atomic_log_histogram, num_ops> latency;
+    utils::sharded_counter<> errors;
+    // Requests submitted but not completed yet.
+    std::atomic_int32_t in_flight = 0;
+    std::atomic_int32_t max_in_flight = 0;
+
+
+    enum device : std::uint8_t {
+        dev_odd,
+        dev_mlc,
+        dev_usb,
+        dev_sd,
+        dev_unknown,
+        num_devices
+    };
+
+    const char* const device_labels[num_devices] = {
+        "ODD",
+        "MLC",
+        "USB",
+        "SD",
+        "?",
+    };
+
+    // Where the running title is installed; /vol/content and /vol/save are there.
+    device title_device = dev_unknown;
+
+    struct file_info {
+        device        dev;
+        std::uint32_t path; // id in the paths arena, 0 if it didn't fit
+    };
+
+    // Guards the handle tables, the paths and the hot files. Zero-initialized, which is
+    // the same as OSInitSpinLock().
+    OSSpinLock handles_lock;
+    utils::ptr_map<file_info, 256> file_handles;
+    utils::ptr_map<device, 16> raw_devices;
+    utils::string_arena<32 * 1024, 2048> paths;
+    // Bytes read from each path, since the HUD was last reset.
+    utils::space_saving<std::uint32_t, 32> hot_files;
+
+
+    struct handles_guard {
+
+        handles_guard()
+        {
+            OSUninterruptibleSpinLock_Acquire(&handles_lock);
+        }
+
+        ~handles_guard()
+        {
+            OSUninterruptibleSpinLock_Release(&handles_lock);
+        }
+
+    };
+
+    // Bumped (under handles_lock) whenever the handle tables change.
+    std::atomic_uint32_t handles_generation = 0;
+
+
+    // Each core remembers the last file handle it looked up, so back-to-back reads of
+    // the same file don't touch handles_lock; the bytes read from it are only added to
+    // hot_files when another file is read, or on a report. The lock is per core, so it's
+    // only ever contended when a report flushes it from another core.
+    struct alignas(32) handle_cache {
+        OSSpinLock    lock;
+        std::uint32_t generation;
+        std::uint32_t handle;
+        bool          valid;
+        bool          known; // false if the handle wasn't in file_handles
+        file_info     info;
+        std::uint64_t pending;
+    };
+
+    std::array<handle_cache, 3> handle_caches;
+
+
+    struct cache_guard {
+
+        handle_cache& cache;
+
+        explicit
+        cache_guard(handle_cache& cache) :
+            cache{cache}
+        {
+            OSUninterruptibleSpinLock_Acquire(&cache.lock);
+        }
+
+        ~cache_guard()
+        {
+            OSUninterruptibleSpinLock_Release(&cache.lock);
+        }
+
+    };
+
+
+    // Adds the bytes read through the cached handle to its path. Only call this with the
+    // cache locked.
+    void
+    flush_hot(handle_cache& cache)
+    {
+        if (!cache.pending)
+            return;
+        handles_guard guard;
+        hot_files.add(cache.info.path, cache.pending);
+        cache.pending = 0;
+    }
+
+
+    void
+    flush_hot_caches()
+    {
+        for (auto& cache : handle_caches) {
+            cache_guard cguard{cache};
+            flush_hot(cache);
+        }
+    }
+
+
+    // Drops the cached lookups, and the bytes not yet added to hot_files. Must be called
+    // without handles_lock.
+    void
+    clear_caches()
+    {
+        for (auto& cache : handle_caches) {
+            cache_guard cguard{cache};
+            cache.valid = false;
+            cache.pending = 0;
+        }
+    }
+
+
+    // Opens and closes are only tracked while something needs the files' devices or
+    // paths. Files opened while not tracking show up as unknown.
+    bool
+    tracking_files()
+    {
+        return cfg::enabled && (cfg::fs_devices || cfg::fs_hot);
+    }
+
+
+    // Only call this with handles_lock held.
+    void
+    clear_handles()
+    {
+        file_handles.clear();
+        raw_devices.clear();
+        handles_generation.fetch_add(1, std::memory_order_release);
+    }
+
+    std::array<utils::sharded_counter<>, num_devices> device_bytes;
+    // Read latency per device, in microseconds.
+    std::array<utils::atomic_log_histogram, num_devices> device_latency;
+
+
+    struct ContextWrapper {
+        IOSAsyncCallbackFn realCallback;
+        void*              realContext;
+        FSAShimBuffer*     shim;
+        OSTime             submitted; // 0 if not timed
+    };
+
+    // Each FS client can't have many requests in flight, so this is plenty for a few
+    // clients reading at once. When it runs out, reads still happen, but aren't counted.
+    utils::object_pool<ContextWrapper, 128> wrapper_pool;
+    // Reads and writes that found the pool exhausted, so their bytes weren't counted.
+    std::atomic_uint32_t missed_transfers = 0;
+    std::uint32_t last_missed_transfers = 0;
+    // Opens and closes that found the pool exhausted, so their handles weren't tracked.
+    std::atomic_uint32_t untracked_handles = 0;
+    std::uint32_t last_untracked = 0;
+
+
+    /*
+     * I/O trace recorder
+     *
+     * When enabled, each completed request is encoded (see io_trace.hpp) into a ring in
+     * memory, under a spinlock. A low priority thread writes the ring to the SD card in
+     * 32 KiB chunks, so the game's requests never wait on the SD card. When the ring is
+     * full, or an async request can't be tracked because the context pool is exhausted,
+     * records are dropped, and counted in the end record.
+     */
+    namespace trace {
+
+        // Both must be powers of two.
+        const std::uint32_t ring_size = 512 * 1024;
+        const std::uint32_t chunk_size = 32 * 1024;
+
+        const std::uint32_t poll_period_ms = 50;
+
+        // Lower priority than most game threads (0 is the highest, 31 the lowest).
+        const std::int32_t thread_priority = 28;
+
+        const char* const trace_dir = "fs:/vol/external01/wiiu/papaya-hud";
+
+        // Only changed under the lock; read without it to skip the lock when off.
+        std::atomic_bool active = false;
+
+        // Zero-initialized, like handles_lock.
+        OSSpinLock lock;
+        std::uint8_t* ring = nullptr;
+        std::atomic_uint32_t head = 0; // only written under the lock
+        std::atomic_uint32_t tail = 0; // only written by the flush thread
+        std::uint64_t prev_time = 0;   // under the lock
+        std::uint32_t dropped = 0;     // under the lock
+
+        std::FILE* file = nullptr;
+        OSThread thread;
+        alignas(16) std::uint8_t thread_stack[16 * 1024];
+        std::atomic_bool quit_requested = false;
+
+
+        std::uint64_t
+        now_us()
+        {
+            return OSTicksToMicroseconds(OSGetTime());
+        }
+
+
+        // Writes out whole chunks; or everything, when finishing.
+        void
+        flush(bool all)
+        {
+            for (;;) {
+                const std::uint32_t h = head.load(std::memory_order_acquire);
+                const std::uint32_t t = tail.load(std::memory_order_relaxed);
+                std::uint32_t n = h - t;
+                if (n >= chunk_size)
+                    n = chunk_size;
+                else if (!all || !n)
+                    return;
+                const std::uint32_t pos = t & (ring_size - 1);
+                n = std::min(n, ring_size - pos);
+                if (std::fwrite(ring + pos, 1, n, file) != n)
+                    logger::printf("Failed to write I/O trace.\n");
+                tail.store(t + n, std::memory_order_release);
+            }
+        }
+
+
+        int
+        thread_main(int, const char**)
+        {
+            while (!quit_requested) {
+                OSSleepTicks(OSMillisecondsToTicks(poll_period_ms));
+                flush(false);
+            }
+            flush(true);
+            return 0;
+        }
+
+
+        void
+        start(std::uint64_t title_id)
+        {
+            if (active)
+                return;
+
+            ring = static_cast<std::uint8_t*>(std::aligned_alloc(64, ring_size));
+            if (!ring) {
+                logger::printf("Failed to allocate I/O trace ring.\n");
+                return;
+            }
+
+            const std::uint64_t start_time = now_us();
+            mkdir(trace_dir, 0777);
+            char path[128];
+            std::snprintf(path, sizeof path,
+                          "%s/%016llx-%llu.iotrace",
+                          trace_dir,
+                          static_cast<unsigned long long>(title_id),
+                          static_cast<unsigned long long>(start_time / 1000000));
+            file = std::fopen(path, "wb");
+            if (!file) {
+                logger::printf("Failed to create I/O trace \"%s\".\n", path);
+                std::free(ring);
+                ring = nullptr;
+                return;
+            }
+            // The flush thread already writes in large chunks.
+            std::setvbuf(file, nullptr, _IONBF, 0);
+
+            std::uint8_t header[io_trace::header_size];
+            io_trace::encode_header(header, {title_id, start_time});
+            std::fwrite(header, 1, sizeof header, file);
+
+            head = 0;
+            tail = 0;
+            prev_time = start_time;
+            dropped = 0;
+            quit_requested = false;
+
+            if (!OSCreateThread(&thread,
+                                thread_main,
+                                0, nullptr,
+                                thread_stack + sizeof thread_stack,
+                                sizeof thread_stack,
+                                thread_priority,
+                                OS_THREAD_ATTRIB_AFFINITY_ANY)) {
+                logger::printf("Failed to create I/O trace thread.\n");
+                std::fclose(file);
+                file = nullptr;
+                std::free(ring);
+                ring = nullptr;
+                return;
+            }
+            OSSetThreadName(&thread, PACKAGE_NAME " I/O trace");
+            OSResumeThread(&thread);
+
+            OSUninterruptibleSpinLock_Acquire(&lock);
+            active = true;
+            OSUninterruptibleSpinLock_Release(&lock);
+
+            logger::printf("Recording I/O trace to \"%s\".\n", path);
+        }
+
+
+        void
+        stop()
+        {
+            if (!active)
+                return;
+
+            // No request can touch the ring after this.
+            OSUninterruptibleSpinLock_Acquire(&lock);
+            active = false;
+            OSUninterruptibleSpinLock_Release(&lock);
+
+            quit_requested = true;
+            OSJoinThread(&thread, nullptr);
+
+            std::uint8_t end[io_trace::max_record_size];
+            const auto end_size = io_trace::encode_end(end, now_us(), prev_time, dropped)
+                                  - end;
+            std::fwrite(end, 1, end_size, file);
+            std::fclose(file);
+            file = nullptr;
+            std::free(ring);
+            ring = nullptr;
+
+            if (dropped)
+                logger::printf("I/O trace: %u records dropped.\n", dropped);
+        }
+
+
+        void
+        append(const io_trace::record& r)
+        {
+            // Large enough for an open's path.
+            std::uint8_t buf[io_trace::max_record_size + sizeof FSARequestOpenFile::path];
+
+            OSUninterruptibleSpinLock_Acquire(&lock);
+            if (active) {
+                io_trace::record rec = r;
+                rec.time = now_us();
+                std::uint64_t time = prev_time;
+                const std::uint32_t len = io_trace::encode_record(buf, rec, time) - buf;
+                const std::uint32_t h = head.load(std::memory_order_relaxed);
+                const std::uint32_t used = h - tail.load(std::memory_order_acquire);
+                if (ring_size - used < len)
+                    ++dropped;
+                else {
+                    prev_time = time;
+                    const std::uint32_t pos = h & (ring_size - 1);
+                    const std::uint32_t first = std::min(len, ring_size - pos);
+                    std::memcpy(ring + pos, buf, first);
+                    std::memcpy(ring, buf + first, len - first);
+                    head.store(h + len, std::memory_order_release);
+                }
+            }
+            OSUninterruptibleSpinLock_Release(&lock);
+        }
+
+
+        // An async request that won't be seen when it completes.
+        void
+        on_missed()
+        {
+            OSUninterruptibleSpinLock_Acquire(&lock);
+            if (active)
+                ++dropped;
+            OSUninterruptibleSpinLock_Release(&lock);
+        }
+
+
+        void
+        on_complete(const FSAShimBuffer* shim,
+                    int res,
+                    std::uint32_t latency_us)
+        {
+            // Don't record the trace's own writes.
+            if (OSGetCurrentThread() == &thread)
+                return;
+
+            const auto& req = shim->request;
+            io_trace::record r{};
+            r.command = shim->command;
+            r.latency = latency_us;
+            r.status = res;
+
+            switch (shim->command) {
+            case FSA_COMMAND_READ_FILE:
+                r.handle = req.readFile.handle;
+                r.size = req.readFile.size;
+                r.count = req.readFile.count;
+                r.has_offset = req.readFile.readFlags & FSA_READ_FLAG_READ_WITH_POS;
+                r.offset = req.readFile.pos;
+                break;
+            case FSA_COMMAND_WRITE_FILE:
+                r.handle = req.writeFile.handle;
+                r.size = req.writeFile.size;
+                r.count = req.writeFile.count;
+                r.has_offset = req.writeFile.writeFlags & FSA_WRITE_FLAG_WRITE_WITH_POS;
+                r.offset = req.writeFile.pos;
+                break;
+            case FSA_COMMAND_RAW_READ:
+                r.handle = req.rawRead.device_handle;
+                r.size = req.rawRead.size;
+                r.count = req.rawRead.count;
+                r.has_offset = true;
+                r.offset = req.rawRead.blocks_offset;
+                break;
+            case FSA_COMMAND_RAW_WRITE:
+                r.handle = req.rawWrite.device_handle;
+                r.size = req.rawWrite.size;
+                r.count = req.rawWrite.count;
+                r.has_offset = true;
+                r.offset = req.rawWrite.blocks_offset;
+                break;
+            case FSA_COMMAND_SET_POS_FILE:
+                r.handle = req.setPosFile.handle;
+                r.has_offset = true;
+                r.offset = req.setPosFile.pos;
+                break;
+            case FSA_COMMAND_STAT_FILE:
+                r.handle = req.statFile.handle;
+                break;
+            case FSA_COMMAND_CLOSE_FILE:
+                r.handle = req.closeFile.handle;
+                break;
+            case FSA_COMMAND_RAW_CLOSE:
+                r.handle = req.rawClose.handle;
+                break;
+            case FSA_COMMAND_OPEN_FILE:
+                if (res >= 0)
+                    r.handle = shim->response.openFile.handle;
+                r.path = {req.openFile.path,
+                          strnlen(req.openFile.path, sizeof req.openFile.path)};
+                break;
+            case FSA_COMMAND_RAW_OPEN:
+                if (res >= 0)
+                    r.handle = shim->response.rawOpen.handle;
+                r.path = {req.rawOpen.path,
+                          strnlen(req.rawOpen.path, sizeof req.rawOpen.path)};
+                break;
+            default:
+                ;
+            }
+
+            append(r);
+        }
+
+    } // namespace trace
+
+
+    device
+    find_title_device()
+    {
+        int handle = MCP_Open();
+        if (handle < 0) {
+            logger::printf("MCP_Open() failed: %d\n", handle);
+            return dev_unknown;
+        }
+        MCPTitleListType info{};
+        MCPError err = MCP_GetTitleInfo(handle, OSGetTitleID(), &info);
+        MCP_Close(handle);
+        if (err) {
+            logger::printf("MCP_GetTitleInfo() failed: %d\n", static_cast<int>(err));
+            return dev_unknown;
+        }
+        std::string_view dev = info.indexedDevice;
+        if (dev == "odd")
+            return dev_odd;
+        if (dev == "mlc" || dev == "slc")
+            return dev_mlc;
+        if (dev == "usb")
+            return dev_usb;
+        return dev_unknown;
+    }
 
 
     void
@@ -46,78 +600,474 @@ namespace fs_mon {
     }
 
 
+    void
+    on_application_start()
+    {
+        title_device = find_title_device();
+        clear_caches();
+        {
+            handles_guard guard;
+            clear_handles();
+            paths.clear();
+            hot_files.clear();
+        }
+        if (cfg::fs_trace)
+            trace::start(OSGetTitleID());
+    }
+
+
+    void
+    on_application_ends()
+    {
+        trace::stop();
+    }
+
+
+    // Logs the hot files. The paths are only cleared when an application starts, so they
+    // can be read without the lock.
+    void
+    dump_hot_files()
+    {
+        std::array<decltype(hot_files)::counter, 16> top;
+        std::size_t n;
+        std::uint64_t total;
+        std::uint32_t path_failures;
+        flush_hot_caches();
+        {
+            handles_guard guard;
+            n = hot_files.top(top);
+            total = hot_files.total;
+            path_failures = paths.failures;
+        }
+        if (!n)
+            return;
+        logger::printf("Hot files, out of %.1f MiB read (%u paths not interned):\n",
+                       total / (1024.0 * 1024.0),
+                       static_cast<unsigned>(path_failures));
+        for (std::size_t i = 0; i < n; ++i)
+            logger::printf("  %8.1f MiB (±%.1f)  %s\n",
+                           top[i].count / (1024.0 * 1024.0),
+                           top[i].error / (1024.0 * 1024.0),
+                           top[i].key ? paths.get(top[i].key) : "(unknown)");
+    }
+
+
     void
     finalize()
-    {}
+    {
+        if (cfg::fs_hot)
+            dump_hot_files();
+
+        const unsigned exhausted = wrapper_pool.exhausted.load(std::memory_order_relaxed);
+        if (exhausted)
+            logger::printf("FS context pool: %u requests not counted (%u reads/writes,"
+                           " %u opens/closes), peak %u of %u\n",
+                           exhausted,
+                           static_cast<unsigned>(missed_transfers.load()),
+                           static_cast<unsigned>(untracked_handles.load()),
+                           static_cast<unsigned>(wrapper_pool.peak.load()),
+                           static_cast<unsigned>(wrapper_pool.slots.size()));
+
+        // Closes aren't seen while hidden, so the handles would go stale.
+        handles_guard guard;
+        clear_handles();
+    }
 
 
     void
     reset()
     {
-        bytes_read = 0;
+        bytes_read.clear();
+        bytes_written.clear();
+        for (auto& c : device_bytes)
+            c.clear();
+        for (auto& h : latency)
+            h.clear();
+        for (auto& h : device_latency)
+            h.clear();
+        errors.clear();
+        max_in_flight.store(in_flight.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+        last_missed_transfers = missed_transfers.load(std::memory_order_relaxed);
+        last_untracked = untracked_handles.load(std::memory_order_relaxed);
+        clear_caches();
+        handles_guard guard;
+        hot_files.clear();
+        if (!tracking_files())
+            clear_handles();
+    }
+
+
+    // Throughput and median read latency of every device that was used.
+    int
+    print_devices(char* buf,
+                  std::size_t buf_size,
+                  float dt)
+    {
+        static utils::log_histogram hist;
+
+        unsigned pos = std::snprintf(buf, buf_size, "RD:");
+        bool idle = true;
+        for (unsigned d = 0; d < num_devices; ++d) {
+            const float bytes = device_bytes[d].take();
+            device_latency[d].take(hist);
+            if (!bytes && !hist.count)
+                continue;
+            if (pos < buf_size)
+                pos += std::snprintf(buf + pos, buf_size - pos,
+                                     "%s %s %.1f MiB/s",
+                                     idle ? "" : " |",
+                                     device_labels[d],
+                                     bytes / (1024.0f * 1024.0f) / dt);
+            if (hist.count && pos < buf_size)
+                pos += std::snprintf(buf + pos, buf_size - pos,
+                                     " %.1f ms",
+                                     hist.quantile(0.5f) / 1000);
+            idle = false;
+        }
+        if (idle && pos < buf_size)
+            pos += std::snprintf(buf + pos, buf_size - pos, " idle");
+
+        // Files whose device is unknown, because their open found the pool exhausted.
+        const std::uint32_t untracked = untracked_handles.load(std::memory_order_relaxed);
+        if (untracked != last_untracked && pos < buf_size)
+            pos += std::snprintf(buf + pos, buf_size - pos,
+                                 " (%u untracked)",
+                                 static_cast<unsigned>(untracked - last_untracked));
+        last_untracked = untracked;
+        return pos;
     }
 
 
     const char*
     get_report(float dt)
     {
-        static char buf[64];
+        static char buf[128];
 
-        unsigned read = std::atomic_exchange(&bytes_read, 0u);
+        const float read = bytes_read.take();
+        const float written = bytes_written.take();
         float read_rate = read / (1024.0f * 1024.0f) / dt;
 
-        std::snprintf(buf, sizeof buf,
-                      "RD: %.1f MiB/s",
-                      read_rate);
+        int len;
+        if (cfg::fs_devices)
+            len = print_devices(buf, sizeof buf, dt);
+        else if (written)
+            len = std::snprintf(buf, sizeof buf,
+                                "RD: %.1f MiB/s WR: %.1f MiB/s",
+                                read_rate,
+                                written / (1024.0f * 1024.0f) / dt);
+        else
+            len = std::snprintf(buf, sizeof buf,
+                                "RD: %.1f MiB/s",
+                                read_rate);
+
+        // Reads and writes that couldn't be counted, because the context pool was
+        // exhausted; other requests that missed it don't change the byte counts.
+        const std::uint32_t missed = missed_transfers.load(std::memory_order_relaxed);
+        if (missed != last_missed_transfers && len > 0 && unsigned(len) < sizeof buf)
+            std::snprintf(buf + len, sizeof buf - len,
+                          " (%u RD/WR uncounted)",
+                          static_cast<unsigned>(missed - last_missed_transfers));
+        last_missed_transfers = missed;
+
+        return buf;
+    }
+
+
+    const char*
+    get_io_report(float dt)
+    {
+        static char buf[160];
+        static utils::log_histogram hist;
+
+        unsigned pos = std::snprintf(buf, sizeof buf, "I/O:");
+        bool idle = true;
+        for (unsigned op = 0; op < num_ops; ++op) {
+            latency[op].take(hist);
+            if (!hist.count || op == op_other)
+                continue;
+            idle = false;
+            if (pos < sizeof buf)
+                pos += std::snprintf(buf + pos, sizeof buf - pos,
+                                     " %s %.0f/s %.1f/%.1f ms",
+                                     op_labels[op],
+                                     hist.count / dt,
+                                     hist.quantile(0.5f) / 1000,
+                                     hist.quantile(0.99f) / 1000);
+        }
+        if (idle && pos < sizeof buf)
+            pos += std::snprintf(buf + pos, sizeof buf - pos, " idle");
+
+        // Queue depth: now, and the most since the last report.
+        const int depth = in_flight.load(std::memory_order_relaxed);
+        const int max_depth = max_in_flight.exchange(depth, std::memory_order_relaxed);
+        if (pos < sizeof buf)
+            pos += std::snprintf(buf + pos, sizeof buf - pos,
+                                 " QD %d/%d",
+                                 depth, max_depth);
+
+        const float error_rate = errors.take() / dt;
+        if (error_rate > 0 && pos < sizeof buf)
+            pos += std::snprintf(buf + pos, sizeof buf - pos,
+                                 " %.1f err/s",
+                                 error_rate);
+
+        return buf;
+    }
+
+
+    // The files that were read the most since the last reset, by name only.
+    const char*
+    get_hot_report(float /*dt*/)
+    {
+        static char buf[160];
+
+        std::array<decltype(hot_files)::counter, 3> top;
+        std::size_t n;
+        flush_hot_caches();
+        {
+            handles_guard guard;
+            n = hot_files.top(top);
+        }
+        if (!n)
+            return "Hot: ?";
+
+        unsigned pos = std::snprintf(buf, sizeof buf, "Hot:");
+        for (std::size_t i = 0; i < n; ++i) {
+            const char* name = "?";
+            if (top[i].key) {
+                name = paths.get(top[i].key);
+                if (const char* slash = std::strrchr(name, '/'))
+                    name = slash + 1;
+            }
+            if (pos < sizeof buf)
+                pos += std::snprintf(buf + pos, sizeof buf - pos,
+                                     "%s %.24s %.1f MiB",
+                                     i ? "," : "",
+                                     name,
+                                     top[i].count / (1024.0f * 1024.0f));
+        }
         return buf;
     }
 
 
     // Code below was suggested by Maschell, with some modifications.
 
+    op_kind
+    classify(FSACommand command)
+    {
+        switch (command) {
+        case FSA_COMMAND_READ_FILE:
+        case FSA_COMMAND_RAW_READ:
+            return op_read;
+        case FSA_COMMAND_WRITE_FILE:
+        case FSA_COMMAND_RAW_WRITE:
+            return op_write;
+        case FSA_COMMAND_OPEN_FILE:
+        case FSA_COMMAND_OPEN_DIR:
+        case FSA_COMMAND_RAW_OPEN:
+            return op_open;
+        case FSA_COMMAND_STAT_FILE:
+        case FSA_COMMAND_GET_INFO_BY_QUERY:
+            return op_stat;
+        default:
+            return op_other;
+        }
+    }
+
+
+    // Returns the submit time, or 0 if the request shouldn't be timed.
+    OSTime
+    on_submit()
+    {
+        const bool timed = trace::active.load(std::memory_order_relaxed)
+                           || (cfg::enabled && (cfg::fs_io || cfg::fs_devices));
+        if (!timed)
+            return 0;
+        const int depth = in_flight.fetch_add(1, std::memory_order_relaxed) + 1;
+        int max = max_in_flight.load(std::memory_order_relaxed);
+        while (depth > max
+               && !max_in_flight.compare_exchange_weak(max, depth,
+                                                       std::memory_order_relaxed))
+            ;
+        return OSGetSystemTime();
+    }
+
+
+    device
+    path_device(std::string_view path)
+    {
+        if (path.starts_with("/vol/content"sv) || path.starts_with("/vol/aoc"sv))
+            return title_device;
+        // Disc games keep their saves in the internal storage.
+        if (path.starts_with("/vol/save"sv))
+            return title_device == dev_odd ? dev_mlc : title_device;
+        if (path.starts_with("/vol/storage_mlc"sv)
+            || path.starts_with("/vol/storage_slc"sv)
+            || path.starts_with("/dev/mlc"sv)
+            || path.starts_with("/dev/slc"sv))
+            return dev_mlc;
+        if (path.starts_with("/vol/storage_usb"sv) || path.starts_with("/dev/usb"sv))
+            return dev_usb;
+        if (path.starts_with("/vol/external"sv) || path.starts_with("/dev/sdcard"sv))
+            return dev_sd;
+        if (path.starts_with("/vol/storage_odd"sv) || path.starts_with("/dev/odd"sv))
+            return dev_odd;
+        return dev_unknown;
+    }
+
+
+    const void*
+    handle_key(std::uint32_t handle)
+    {
+        return reinterpret_cast<const void*>(std::uintptr_t{handle});
+    }
+
+
+    device
+    find_raw_device(std::uint32_t handle)
+    {
+        handles_guard guard;
+        const device* dev = raw_devices.find(handle_key(handle));
+        return dev ? *dev : dev_unknown;
+    }
+
+
+    // Finds the file's device, and adds the bytes read to its path.
+    device
+    on_file_io(std::uint32_t handle,
+               std::uint32_t read)
+    {
+        handle_cache& cache = handle_caches[OSGetCoreId()];
+        cache_guard cguard{cache};
+        if (!cache.valid
+            || cache.handle != handle
+            || cache.generation != handles_generation.load(std::memory_order_acquire)) {
+            flush_hot(cache);
+            handles_guard guard;
+            const file_info* info = file_handles.find(handle_key(handle));
+            cache.known = info;
+            cache.info = info ? *info : file_info{dev_unknown, 0};
+            cache.handle = handle;
+            cache.generation = handles_generation.load(std::memory_order_relaxed);
+            cache.valid = true;
+        }
+        if (read && cfg::fs_hot && cache.known)
+            cache.pending += read;
+        return cache.info.dev;
+    }
+
+
+    // Called when a request completes, with its FSA status, and its submit time (0 if
+    // it wasn't timed).
     void
-    update_stats(FSAShimBuffer* shim, int res)
+    update_stats(FSAShimBuffer* shim,
+                 int res,
+                 OSTime submitted)
     {
+        std::uint32_t elapsed_us = 0;
+        if (submitted) {
+            elapsed_us = OSTicksToMicroseconds(OSGetSystemTime() - submitted);
+            latency[classify(shim->command)].add(elapsed_us);
+            if (res < 0)
+                errors.add(OSGetCoreId(), 1);
+            in_flight.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        if (trace::active.load(std::memory_order_relaxed))
+            trace::on_complete(shim, res, elapsed_us);
+
         if (res < 0)
             return;
 
-        // TODO: we can track more stuff in here, right now there isn't much screen space
-        // in the HUD for it all.
+        std::uint32_t read = 0;
+        std::uint32_t written = 0;
+        std::optional<device> dev;
+        const bool per_file = tracking_files();
+        const bool per_device = per_file && cfg::fs_devices;
+        const auto& req = shim->request;
+
         switch (shim->command) {
         case FSA_COMMAND_READ_FILE:
-            bytes_read += shim->request.readFile.size * res;
+            read = req.readFile.size * res;
+            if (per_file)
+                dev = on_file_io(req.readFile.handle, read);
             break;
         case FSA_COMMAND_RAW_READ:
-            bytes_read += shim->request.rawRead.size * res;
+            read = req.rawRead.size * res;
+            if (per_device)
+                dev = find_raw_device(req.rawRead.device_handle);
+            break;
+        case FSA_COMMAND_WRITE_FILE:
+            written = req.writeFile.size * res;
+            if (per_file)
+                dev = on_file_io(req.writeFile.handle, 0);
             break;
-        // case FSA_COMMAND_WRITE_FILE:
-        //     bytes_written += shim->request.writeFile.size * res;
-        //     break;
-        // case FSA_COMMAND_RAW_WRITE:
-        //     bytes_written += shim->request.rawWrite.size * res;
-        //     break;
+        case FSA_COMMAND_RAW_WRITE:
+            written = req.rawWrite.size * res;
+            if (per_device)
+                dev = find_raw_device(req.rawWrite.device_handle);
+            break;
+        case FSA_COMMAND_OPEN_FILE:
+            if (per_file) {
+                const std::string_view path{req.openFile.path,
+                                            strnlen(req.openFile.path,
+                                                    sizeof req.openFile.path)};
+                handles_guard guard;
+                // Only the hot files need the path.
+                const std::uint32_t path_id = cfg::fs_hot ? paths.intern(path) : 0;
+                file_handles.insert(handle_key(shim->response.openFile.handle),
+                                    {path_device(path), path_id});
+                handles_generation.fetch_add(1, std::memory_order_release);
+            }
+            break;
+        case FSA_COMMAND_CLOSE_FILE:
+            if (per_file) {
+                handles_guard guard;
+                file_handles.erase(handle_key(req.closeFile.handle));
+                handles_generation.fetch_add(1, std::memory_order_release);
+            }
+            break;
+        case FSA_COMMAND_RAW_OPEN:
+            if (per_file) {
+                handles_guard guard;
+                raw_devices.insert(handle_key(shim->response.rawOpen.handle),
+                                   path_device(req.rawOpen.path));
+            }
+            break;
+        case FSA_COMMAND_RAW_CLOSE:
+            if (per_file) {
+                handles_guard guard;
+                raw_devices.erase(handle_key(req.rawClose.handle));
+            }
+            break;
+        default:
+            ;
         }
-    }
 
-
-    struct ContextWrapper {
-        IOSAsyncCallbackFn realCallback;
-        void*              realContext;
-        FSAShimBuffer*     shim;
-    };
+        if (read)
+            bytes_read.add(OSGetCoreId(), read);
+        if (written)
+            bytes_written.add(OSGetCoreId(), written);
+        if (dev && per_device) {
+            device_bytes[*dev].add(OSGetCoreId(), read + written);
+            if (read && submitted)
+                device_latency[*dev].add(elapsed_us);
+        }
+    }
 
 
     void
     async_callback(IOSError result, void* context)
     {
         auto wrapper = static_cast<ContextWrapper*>(context);
-        update_stats(wrapper->shim,
-                     __FSAShimDecodeIosErrorToFsaStatus(wrapper->shim->clientHandle,
-                                                        result));
+        const int res = __FSAShimDecodeIosErrorToFsaStatus(wrapper->shim->clientHandle,
+                                                           result);
+        update_stats(wrapper->shim, res, wrapper->submitted);
         if (wrapper->realCallback)
             wrapper->realCallback(result, wrapper->realContext);
 
-        delete wrapper;
+        wrapper_pool.destroy(wrapper);
     }
 
 
@@ -125,8 +1075,9 @@ namespace fs_mon {
                   FSAShimBuffer* shim,
                   FSError emulatedError)
     {
+        const OSTime submitted = on_submit();
         auto res = real_fsaShimSubmitRequest(shim, emulatedError);
-        update_stats(shim, res);
+        update_stats(shim, res, submitted);
         return res;
     }
 
@@ -141,26 +1092,38 @@ namespace fs_mon {
                   IOSAsyncCallbackFn callback,
                   void* context)
     {
-        switch (shim->command) {
-        case FSA_COMMAND_READ_FILE:
-        case FSA_COMMAND_RAW_READ:
-            {
-                auto wrapper = new(std::nothrow) ContextWrapper{
+        // Reads and writes always need the callback, to count bytes; opens and closes
+        // only when tracking handles; everything else only when timing or tracing.
+        const op_kind kind = classify(shim->command);
+        const bool close = shim->command == FSA_COMMAND_CLOSE_FILE
+                           || shim->command == FSA_COMMAND_RAW_CLOSE;
+        const bool handle_change = (kind == op_open || close) && tracking_files();
+        if (kind == op_read || kind == op_write || handle_change
+            || cfg::fs_io || trace::active.load(std::memory_order_relaxed)) {
+            auto wrapper = wrapper_pool.create(ContextWrapper{
                     .realCallback = callback,
                     .realContext = context,
-                    .shim = shim
-                };
-                if (!wrapper)
-                    break; // fall back to original callback and context
-
+                    .shim = shim,
+                    .submitted = 0
+                });
+            if (wrapper) {
+                wrapper->submitted = on_submit();
                 auto result = real_fsaShimSubmitRequestAsync(shim, emulatedError,
                                                              async_callback, wrapper);
-                if (result != FS_ERROR_OK) {
-                    delete wrapper;
-                    break; // fall back to original callback and context
-                }
+                if (result == FS_ERROR_OK)
+                    return result;
 
-                return result;
+                if (wrapper->submitted)
+                    in_flight.fetch_sub(1, std::memory_order_relaxed);
+                wrapper_pool.destroy(wrapper);
+                // fall back to original callback and context
+            } else {
+                if (kind == op_read || kind == op_write)
+                    missed_transfers.fetch_add(1, std::memory_order_relaxed);
+                if (handle_change)
+                    untracked_handles.fetch_add(1, std::memory_order_relaxed);
+                if (trace::active.load(std::memory_order_relaxed))
+                    trace::on_missed();
             }
         }
 
@@ -13,8 +13,14 @@ namespace fs_mon {
 
     void initialize();
     void finalize();
+
+    void on_application_start();
+    void on_application_ends();
+
     void reset();
     const char* get_report(float dt);
+    const char* get_io_report(float dt);
+    const char* get_hot_report(float dt);
 
 }
 
@@ -16,35 +16,62 @@
  *
  * We also hook into `GX2Init()` and `GX2Shutdown()`, to ensure we don't call GX2Perf
  * functions while GX2 is in an invalid state.
+ *
+ * The native overlay draws itself into the color buffer from the
+ * `GX2CopyColorBufferToScanBuffer()` hook.
  */
 
 
+#include <algorithm>            // clamp(), max()
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>              // malloc(), free()
+#include <mutex>
 #include <optional>
 #include <ranges>
 // #include <source_location>
 #include <variant>
-#include <vector>
 
+#include <coreinit/cache.h>     // DCFlushRange(), DCInvalidateRange()
+#include <coreinit/core.h>      // OSGetCoreId()
 #include <coreinit/debug.h> // DEBUG
-#include <coreinit/memexpheap.h>
-#include <coreinit/memunitheap.h>
-#include <gx2/event.h>          // GX2DrawDone()
+#include <coreinit/time.h>
+#include <gx2/display_list.h>  // GX2GetDisplayListWriteStatus()
+#include <gx2/draw.h>
+#include <gx2/event.h>          // GX2DrawDone(), GX2GetRetiredTimeStamp()
+#include <gx2/registers.h>
+#include <gx2/shaders.h>
+#include <gx2/state.h>          // GX2Flush()
+#include <gx2/surface.h>
+#include <gx2/swap.h>
+#include <gx2/texture.h>
+#include <gx2r/buffer.h>
+#include <gx2r/surface.h>
 #include <wups.h>
 
 #include <memory/mappedmemory.h>
 
 // WUT lacks <gx2/perf.h>
 #include "gx2_perf.h"
+// WUT also lacks GX2Sample*GPUCycle()
+#include "gx2_timestamp.h"
 // WUT also lacks <coreinit/allocator.h>
 #include "coreinit_allocator.h"
 
 #include "gx2_mon.hpp"
 
 #include "cfg.hpp"
+#include "gx2_overlay.hpp"
+#include "log_histogram.hpp"
 #include "logger.hpp"
 #include "overlay.hpp"
+#include "ptr_map.hpp"
+#include "sample_ring.hpp"
+#include "sharded_counter.hpp"
+#include "size_class_pool.hpp"
 #include "utils.hpp"
 
 
@@ -58,48 +85,40 @@
     while (false)
 
 
-#define USE_UNIT_HEAP
-
 namespace {
 
     void* lmm_ptr = nullptr;
-    const std::uint32_t lmm_size = 4096;
-    const std::uint32_t lmm_align = 32;
-
-#ifdef USE_UNIT_HEAP
-    const std::uint32_t lmm_unit_size = 32;
-#endif
-
-    MEMHeapHandle lmm_handle = nullptr;
+    // Room for all the GX2PerfData instances used in pipelined readback, and for the
+    // render pass profiler.
+    const std::uint32_t lmm_size = 65536;
+    const std::uint32_t lmm_align = utils::size_class_pool::max_block_size;
 
+    utils::size_class_pool lmm_pool;
+    // GX2PerfInit() can't report failures, so this is checked after calling it.
+    unsigned lmm_alloc_failures = 0;
 
-    MEMAllocatorAlloc real_allocator_alloc = nullptr;
 
     void*
-    my_allocator_alloc(MEMAllocator* a, std::uint32_t size)
+    my_allocator_alloc(MEMAllocator* /*a*/, std::uint32_t size)
     {
-#ifdef USE_UNIT_HEAP
-        if (size > lmm_unit_size) {
-            logger::printf("ERROR: trying to allocate %u, but can only allocate up to %u.\n",
+        void* result = lmm_pool.alloc(size);
+        if (!result) {
+            ++lmm_alloc_failures;
+            logger::printf("ERROR: failed to allocate %u bytes (largest block is %u).\n",
                            size,
-                           lmm_unit_size);
-            return nullptr;
+                           utils::size_class_pool::max_block_size);
         }
-#endif
-
-        void* result = real_allocator_alloc(a, size);
         // logger::printf("allocating %u bytes: %p\n", size, result);
         return result;
     }
 
 
-    MEMAllocatorFree real_allocator_free = nullptr;
-
     void
-    my_allocator_free(MEMAllocator* a, void* ptr)
+    my_allocator_free(MEMAllocator* /*a*/, void* ptr)
     {
         // logger::printf("freeing %p\n", ptr);
-        return real_allocator_free(a, ptr);
+        if (!lmm_pool.free(ptr))
+            logger::printf("ERROR: freeing %p, that doesn't belong to the pool.\n", ptr);
     }
 
 
@@ -115,24 +134,15 @@ namespace {
         if (!lmm_ptr)
             OSFatal("ERROR!!!!!! could not allocate memory for lmm_ptr\n");
 
-#ifdef USE_UNIT_HEAP
-        std::uint32_t total_free = lmm_unit_size * MEMCountFreeBlockForUnitHeap(lmm_handle);
-#else
-        std::uint32_t total_free = MEMGetTotalFreeSizeForExpHeap(lmm_handle);
-#endif
-        logger::printf("Heap total free size: %u\n", total_free);
-
-        MEMAllocator result;
-#ifdef USE_UNIT_HEAP
-        MEMInitAllocatorForUnitHeap(&result, lmm_handle);
-#else
-        MEMInitAllocatorForExpHeap(&result, lmm_handle, lmm_align);
-#endif
-        real_allocator_alloc = result.funcs->alloc;
-        real_allocator_free = result.funcs->free;
-        result.funcs = &my_funcs;
+        logger::printf("Pool free size: %u\n",
+                       static_cast<unsigned>(lmm_size - lmm_pool.bytes_used()));
 
-        return result;
+        return MEMAllocator{
+            .funcs = &my_funcs,
+            .heap = nullptr,
+            .arg1 = 0,
+            .arg2 = 0
+        };
     }
 
 
@@ -144,21 +154,8 @@ namespace {
             return;
 
         lmm_ptr = MEMAllocFromMappedMemoryForGX2Ex(lmm_size, lmm_align);
-        if (lmm_ptr) {
-#ifdef USE_UNIT_HEAP
-            lmm_handle = MEMCreateUnitHeapEx(lmm_ptr,
-                                             lmm_size,
-                                             lmm_unit_size,
-                                             lmm_align,
-                                             0);
-#else
-            lmm_handle = MEMCreateExpHeapEx(lmm_ptr, lmm_size, 0);
-#endif
-            if (!lmm_handle) {
-                MEMFreeToMappedMemory(lmm_ptr);
-                lmm_ptr = nullptr;
-            }
-        }
+        if (lmm_ptr)
+            lmm_pool.init(lmm_ptr, lmm_size);
     }
 
 
@@ -166,18 +163,20 @@ namespace {
     void
     finalize_lmm_heap()
     {
-        if (lmm_handle) {
-#ifdef USE_UNIT_HEAP
-            MEMDestroyUnitHeap(lmm_handle);
-#else
-            MEMDestroyExpHeap(lmm_handle);
-#endif
-            lmm_handle = nullptr;
-        }
-        if (lmm_ptr) {
-            MEMFreeToMappedMemory(lmm_ptr);
-            lmm_ptr = nullptr;
-        }
+        if (!lmm_ptr)
+            return;
+
+        for (auto& sc : lmm_pool.classes)
+            if (sc.peak || sc.failures)
+                logger::printf("Pool class %u: %u/%u used, peak %u, %u failures\n",
+                               sc.block_size, sc.used, sc.num_blocks,
+                               sc.peak, sc.failures);
+        if (lmm_pool.oversize_failures)
+            logger::printf("Pool: %u allocations too large\n",
+                           lmm_pool.oversize_failures);
+
+        MEMFreeToMappedMemory(lmm_ptr);
+        lmm_ptr = nullptr;
     }
 
 } // namespace
@@ -189,7 +188,11 @@ namespace {
 namespace gx2 {
 
 
-    using metric_or_stat = std::variant<GX2PerfMetric, GX2StatId>;
+    // The memory statistic IDs are undocumented, so they're just numbers.
+    enum class mem_stat : std::uint32_t {};
+
+
+    using metric_or_stat = std::variant<GX2PerfMetric, GX2StatId, mem_stat>;
 
 
     using metric_result = std::variant<std::uint64_t, float>;
@@ -271,6 +274,15 @@ namespace gx2 {
         }
 
 
+        bool
+        enable_metric(mem_stat stat)
+        {
+            return GX2PerfMetricEnable(&data,
+                                       GX2_PERF_TYPE_MEM_STAT,
+                                       static_cast<std::uint32_t>(stat));
+        }
+
+
         std::optional<metric_or_stat>
         get_metric(std::uint32_t index)
         {
@@ -284,7 +296,8 @@ namespace gx2 {
                 return static_cast<GX2PerfMetric>(id);
             case GX2_PERF_TYPE_GPU_STAT:
                 return static_cast<GX2StatId>(id);
-            case GX2_PERF_TYPE_MEM_STAT: // TODO: figure out how to handle this
+            case GX2_PERF_TYPE_MEM_STAT:
+                return static_cast<mem_stat>(id);
             default:
                 return {};
             }
@@ -391,7 +404,32 @@ namespace gx2 {
             return convert(result, metric);
         }
 
-        // Missing: overload get_frame_result() for GX2StatId
+        // Stats are always 64-bit counters.
+        std::optional<std::uint64_t>
+        get_frame_result(GX2StatId stat)
+            const
+        {
+            GX2MetricResult result;
+            if (!GX2PerfGetResultByFrame(&data,
+                                         GX2_PERF_TYPE_GPU_STAT, stat,
+                                         &result))
+                return {};
+            return result.u64Result;
+        }
+
+
+        std::optional<std::uint64_t>
+        get_frame_result(mem_stat stat)
+            const
+        {
+            GX2MetricResult result;
+            if (!GX2PerfGetResultByFrame(&data,
+                                         GX2_PERF_TYPE_MEM_STAT,
+                                         static_cast<std::uint32_t>(stat),
+                                         &result))
+                return {};
+            return result.u64Result;
+        }
 
 
         std::optional<metric_result>
@@ -410,10 +448,105 @@ namespace gx2 {
             return convert(result, metric);
         }
 
-        // Missing: overload get_tag_result() for GX2StatId
+        std::optional<std::uint64_t>
+        get_tag_result(GX2StatId stat,
+                       unsigned tag,
+                       unsigned number)
+            const
+        {
+            GX2MetricResult result;
+            if (!GX2PerfGetResultByTagId(&data,
+                                         GX2_PERF_TYPE_GPU_STAT, stat,
+                                         tag, number,
+                                         &result))
+                return {};
+            return result.u64Result;
+        }
+
+
+        std::optional<std::uint64_t>
+        get_tag_result(mem_stat stat,
+                       unsigned tag,
+                       unsigned number)
+            const
+        {
+            GX2MetricResult result;
+            if (!GX2PerfGetResultByTagId(&data,
+                                         GX2_PERF_TYPE_MEM_STAT,
+                                         static_cast<std::uint32_t>(stat),
+                                         tag, number,
+                                         &result))
+                return {};
+            return result.u64Result;
+        }
+
+
+        struct tag_result {
+            unsigned      tag;
+            unsigned      number;
+            unsigned      depth;
+            metric_result result;
+        };
+
+
+        // With GX2_PERF_COLLECT_TAGS_INDIVIDUAL, every tag_start()/tag_finish() pair gets
+        // a result, in the order they were issued.
+        std::optional<tag_result>
+        get_tag_sequence_result(GX2PerfMetric metric,
+                                unsigned sequence)
+            const
+        {
+            std::uint32_t tag;
+            std::uint32_t number;
+            std::uint32_t depth;
+            GX2MetricResult result;
+            if (!GX2PerfGetResultByTagSequence(&data,
+                                               GX2_PERF_TYPE_GPU_METRIC, metric,
+                                               sequence,
+                                               &tag, &number, &depth,
+                                               &result))
+                return {};
+            return tag_result{tag, number, depth, convert(result, metric)};
+        }
+
+        std::optional<tag_result>
+        get_tag_sequence_result(GX2StatId stat,
+                                unsigned sequence)
+            const
+        {
+            return get_tag_sequence_result(GX2_PERF_TYPE_GPU_STAT, stat, sequence);
+        }
+
+
+        std::optional<tag_result>
+        get_tag_sequence_result(mem_stat stat,
+                                unsigned sequence)
+            const
+        {
+            return get_tag_sequence_result(GX2_PERF_TYPE_MEM_STAT,
+                                           static_cast<std::uint32_t>(stat),
+                                           sequence);
+        }
 
 
-        // Missing: wrapper for GX2PerfGetResultByTagSequence()
+        std::optional<tag_result>
+        get_tag_sequence_result(GX2PerfType type,
+                                std::uint32_t id,
+                                unsigned sequence)
+            const
+        {
+            std::uint32_t tag;
+            std::uint32_t number;
+            std::uint32_t depth;
+            GX2MetricResult result;
+            if (!GX2PerfGetResultByTagSequence(&data,
+                                               type, id,
+                                               sequence,
+                                               &tag, &number, &depth,
+                                               &result))
+                return {};
+            return tag_result{tag, number, depth, result.u64Result};
+        }
 
 
         // printing
@@ -452,36 +585,147 @@ namespace gx2 {
 
 namespace gx2_mon {
 
+    namespace bottleneck {
+        void add_gpu_busy(float sample);
+        void add_stage(unsigned stage, float sample);
+    }
+
     namespace perf {
 
+        struct stage_metric {
+            GX2PerfMetric metric;
+            const char*   label;
+        };
+
+        // The metrics rotated through, when showing per-stage utilization.
+        const std::array stage_metrics{
+            stage_metric{GX2_PERF_F32_SHADER_BUSY_VS,           "VS"},
+            stage_metric{GX2_PERF_F32_SHADER_BUSY_PS,           "PS"},
+            stage_metric{GX2_PERF_F32_ALU_BUSY,                 "ALU"},
+            stage_metric{GX2_PERF_F32_TEX_BUSY,                 "TEX"},
+            stage_metric{GX2_PERF_F32_PRIMITIVE_ASSEMBLY_BUSY,  "PA"},
+            stage_metric{GX2_PERF_F32_PA_STALLED_ON_RASTERIZER, "RAS"},
+            stage_metric{GX2_PERF_F32_DEPTH_STENCIL_TEST_BUSY,  "DB"},
+            stage_metric{GX2_PERF_F32_PS_EXPORT_STALLS,         "ROP"},
+        };
+
+
+        using metric_stats = utils::running_stats;
+
+
+        bool
+        stages_wanted()
+        {
+            return cfg::gpu_stages || cfg::gpu_bottleneck;
+        }
+
+
+        bool
+        is_wanted()
+        {
+            return cfg::gpu_busy || cfg::gpu_bandwidth || stages_wanted();
+        }
+
+
+        // Color buffers are assumed to be RGBA8, the usual format on the Wii U.
+        const unsigned cb_bytes_per_pixel = 4;
+
+
         struct profiler {
 
+            // How many frames can be in flight, when the readback is pipelined.
+            static constexpr unsigned max_depth = 3;
+            // Only tag 0 is used, to bracket the whole frame; tags for individual passes
+            // are collected by passes::, in the frames this one skips.
+            static constexpr unsigned max_tags = 1;
+
             unsigned pass;
             unsigned num_passes;
             bool frame_open;
             bool pass_open;
             bool started;
             MEMAllocator allocator;
-            gx2::perf_data data;
-
-            bool gpu_busy_enabled;
-            std::vector<float> gpu_busy_vec;
 
-
-            profiler() :
+            // When pipelined, frame K uses ring[K % depth], and its results are only
+            // read back when the slot is reused, after the GPU retired it.
+            bool pipelined;
+            unsigned depth;
+            unsigned current;
+            std::array<std::optional<gx2::perf_data>, max_depth> ring;
+            // Timestamp of the submission that ended each slot's frame; 0 if none.
+            std::array<OSTime, max_depth> submitted;
+            std::array<bool, max_depth> gpu_busy_enabled;
+            unsigned late_results;
+            // Frames that were open while paused, whose results are meaningless.
+            std::array<bool, max_depth> discard;
+
+            // Stage metrics (indices into stage_metrics) enabled for each slot's frame.
+            std::array<std::array<std::uint8_t, stage_metrics.size()>, max_depth> slot_stages;
+            std::array<unsigned, max_depth> slot_num_stages;
+            // The next stage metric to be enabled.
+            unsigned next_stage;
+            // Stage metrics that didn't fit in a pass on their own, already logged.
+            std::array<bool, stage_metrics.size()> stage_unusable;
+            std::array<metric_stats, stage_metrics.size()> stage_stats;
+
+            // Memory traffic, summed over the profiled frames.
+            std::array<bool, max_depth> bandwidth_enabled;
+            std::uint64_t tex_bytes_read;
+            std::uint64_t cb_pixels_written;
+            unsigned bandwidth_frames;
+
+            // Duty cycle: only one of every `period` frames is profiled.
+            bool auto_period;
+            unsigned period;
+            unsigned skip;
+            bool skipping;
+
+            // CPU time spent in the profiler, to measure its overhead.
+            OSTime overhead;
+            unsigned profiled_frames;
+            unsigned total_frames;
+            bool interval_ended;
+
+            utils::running_stats gpu_busy_stats;
+
+
+            profiler(bool pipelined, unsigned sample_period) :
                 pass{0},
                 num_passes{0},
                 frame_open{false},
                 pass_open{false},
                 started{false},
                 allocator{libmappedmemory_allocator()},
-                data{1, allocator},
-                gpu_busy_enabled{false}
+                pipelined{pipelined},
+                depth{pipelined ? max_depth : 1},
+                current{0},
+                submitted{},
+                gpu_busy_enabled{},
+                late_results{0},
+                discard{},
+                slot_num_stages{},
+                next_stage{0},
+                stage_unusable{},
+                bandwidth_enabled{},
+                tex_bytes_read{0},
+                cb_pixels_written{0},
+                bandwidth_frames{0},
+                auto_period{sample_period == 0},
+                period{sample_period ? sample_period : 1},
+                skip{0},
+                skipping{false},
+                overhead{0},
+                profiled_frames{0},
+                total_frames{0},
+                interval_ended{false}
             {
                 // TRACE;
 
-                data.set_collection_method(GX2_PERF_COLLECT_TAGS_ACCUMULATE);
-                data.set_tag(0, true);
+                for (unsigned i = 0; i < depth; ++i) {
+                    auto& data = ring[i].emplace(max_tags, allocator);
+                    data.set_collection_method(GX2_PERF_COLLECT_TAGS_ACCUMULATE);
+                    data.set_tag(0, true);
+                }
             }
 
 
@@ -492,20 +736,182 @@ namespace gx2_mon {
                 // logger::printf("    started = %s\n", started ? "true" : "false");
                 // logger::printf("    pass = %u\n", pass);
                 // logger::printf("    num_passes = %u\n", num_passes);
+
+                // Don't free anything the GPU might still write into.
+                for (unsigned i = 0; i < depth; ++i)
+                    if (submitted[i]) {
+                        stalls::draw_done();
+                        break;
+                    }
+            }
+
+
+            // Enables the memory traffic counters; they're dropped if they don't fit in
+            // a single pass.
+            bool
+            enable_bandwidth(gx2::perf_data& data)
+            {
+                if (!data.enable_metric(GX2_PERF_U64_TEX_MEM_BYTES_READ))
+                    return false;
+                if (!data.enable_metric(GX2_PERF_U64_PIXELS_CB_MEM_WRITTEN)
+                    || data.get_num_passes() > 1) {
+                    data.clear_metrics();
+                    data.enable_metric(GX2_PERF_F32_GPU_BUSY);
+                    return false;
+                }
+                return true;
+            }
+
+
+            // Enables GPU_BUSY and the memory traffic counters, plus as many stage
+            // metrics as fit in a single pass, continuing from where the previous frame
+            // stopped.
+            void
+            setup_metrics(unsigned slot)
+            {
+                auto& data = *ring[slot];
+
+                data.clear_metrics();
+                gpu_busy_enabled[slot] = data.enable_metric(GX2_PERF_F32_GPU_BUSY);
+                if (!gpu_busy_enabled[slot])
+                    logger::printf("no slot available for GPU_BUSY\n");
+
+                bandwidth_enabled[slot] = false;
+                if (cfg::gpu_bandwidth) {
+                    bandwidth_enabled[slot] = enable_bandwidth(data);
+                    if (!bandwidth_enabled[slot])
+                        logger::printf("no slot available for memory traffic\n");
+                }
+
+                auto& stages = slot_stages[slot];
+                unsigned& num_stages = slot_num_stages[slot];
+                num_stages = 0;
+                if (!stages_wanted())
+                    return;
+
+                for (unsigned tried = 0; tried < stage_metrics.size(); ++tried) {
+                    bool fits = data.enable_metric(stage_metrics[next_stage].metric);
+                    if (fits && data.get_num_passes() > 1) {
+                        // It only fits in another pass; enable the others again without it.
+                        data.clear_metrics();
+                        data.enable_metric(GX2_PERF_F32_GPU_BUSY);
+                        if (bandwidth_enabled[slot])
+                            enable_bandwidth(data);
+                        for (unsigned i = 0; i < num_stages; ++i)
+                            data.enable_metric(stage_metrics[stages[i]].metric);
+                        fits = false;
+                    }
+                    if (!fits) {
+                        // Out of counters; this one goes first in the next frame.
+                        if (num_stages)
+                            break;
+                        // It doesn't fit even on its own, so it must be skipped, or no
+                        // other stage would ever be sampled.
+                        skip_stage();
+                        continue;
+                    }
+                    stages[num_stages++] = next_stage;
+                    next_stage = (next_stage + 1) % stage_metrics.size();
+                }
+            }
+
+
+            void
+            skip_stage()
+            {
+                if (!stage_unusable[next_stage]) {
+                    stage_unusable[next_stage] = true;
+                    logger::printf("Can't fit %s busy in one pass, skipping it.\n",
+                                   stage_metrics[next_stage].label);
+                }
+                next_stage = (next_stage + 1) % stage_metrics.size();
+            }
+
+
+            void
+            collect_bandwidth(unsigned slot)
+            {
+                auto tex = ring[slot]->get_frame_result(GX2_PERF_U64_TEX_MEM_BYTES_READ);
+                auto cb = ring[slot]->get_frame_result(GX2_PERF_U64_PIXELS_CB_MEM_WRITTEN);
+                if (!tex || !cb)
+                    return;
+                tex_bytes_read += std::get<std::uint64_t>(*tex);
+                cb_pixels_written += std::get<std::uint64_t>(*cb);
+                ++bandwidth_frames;
+            }
+
+
+            void
+            collect(unsigned slot)
+            {
+                submitted[slot] = 0;
+
+                if (discard[slot]) {
+                    discard[slot] = false;
+                    return;
+                }
+
+                if (bandwidth_enabled[slot])
+                    collect_bandwidth(slot);
+
+                for (unsigned i = 0; i < slot_num_stages[slot]; ++i) {
+                    unsigned idx = slot_stages[slot][i];
+                    auto res = ring[slot]->get_frame_result(stage_metrics[idx].metric);
+                    if (res) {
+                        float sample = std::get<float>(*res);
+                        stage_stats[idx].add(sample);
+                        bottleneck::add_stage(idx, sample);
+                    }
+                }
+
+                if (!gpu_busy_enabled[slot])
+                    return;
+
+                auto gpu_busy_res = ring[slot]->get_frame_result(GX2_PERF_F32_GPU_BUSY);
+                if (gpu_busy_res) {
+                    float sample = std::get<float>(*gpu_busy_res);
+                    bottleneck::add_gpu_busy(sample);
+                    // Only the GPU busy report empties this.
+                    if (cfg::gpu_busy)
+                        gpu_busy_stats.add(sample);
+                } else {
+                    static unsigned error_counter = 0;
+                    ++error_counter;
+                    if (error_counter < 100 || error_counter % 1024 == 0)
+                        logger::printf("failed to get GPU_BUSY result (%u)\n",
+                                       error_counter);
+                }
             }
 
 
             void
             start_frame()
             {
+                if (pass == 0 && skip > 0) {
+                    --skip;
+                    skipping = true;
+                    return;
+                }
+
                 started = true;
 
+                auto& data = *ring[current];
+
                 if (pass == 0) {
+                    // Collect this slot's previous frame, before reusing it.
+                    if (submitted[current]) {
+                        if (GX2GetRetiredTimeStamp() >= submitted[current])
+                            collect(current);
+                        else {
+                            // Still not done by the GPU; drop the sample instead of
+                            // waiting for it.
+                            ++late_results;
+                            submitted[current] = 0;
+                        }
+                    }
+
                     // if on frame start, set up all metrics
-                    data.clear_metrics();
-                    gpu_busy_enabled = data.enable_metric(GX2_PERF_F32_GPU_BUSY);
-                    if (!gpu_busy_enabled)
-                        logger::printf("no slot available for GPU_BUSY\n");
+                    setup_metrics(current);
                     num_passes = data.get_num_passes();
                     data.frame_start();
                     frame_open = true;
@@ -520,9 +926,25 @@ namespace gx2_mon {
             void
             finish_frame()
             {
+                if (interval_ended) {
+                    overhead = 0;
+                    profiled_frames = 0;
+                    total_frames = 0;
+                    interval_ended = false;
+                }
+
+                ++total_frames;
+
+                if (skipping) {
+                    skipping = false;
+                    return;
+                }
+
                 if (!started)
                     return;
 
+                ++profiled_frames;
+
                 if (!frame_open) {
                     logger::printf("ERROR: frame not open\n");
                     return;
@@ -533,6 +955,8 @@ namespace gx2_mon {
                     return;
                 }
 
+                auto& data = *ring[current];
+
                 data.tag_finish(0);
                 data.pass_finish();
                 pass_open = false;
@@ -541,27 +965,101 @@ namespace gx2_mon {
                 // if on last frame
                 if (++pass >= num_passes) {
                     data.frame_finish();
-                    GX2DrawDone();
-                    if (gpu_busy_enabled) {
-                        auto gpu_busy_res = data.get_frame_result(GX2_PERF_F32_GPU_BUSY);
-                        if (gpu_busy_res) {
-                            float sample = std::get<float>(*gpu_busy_res);
-                            if (gpu_busy_vec.size() < 1000)
-                                gpu_busy_vec.push_back(sample);
-                            else
-                                logger::printf("gpu_busy_vec is growing too much! %u\n",
-                                               static_cast<unsigned>(gpu_busy_vec.size()));
-                        } else {
-                            static unsigned error_counter = 0;
-                            ++error_counter;
-                            if (error_counter < 100 || error_counter % 1024 == 0)
-                                logger::printf("failed to get GPU_BUSY result (%u)\n",
-                                               error_counter);
-                        }
+                    if (pipelined) {
+                        // Submit now, so we know which timestamp the results depend on.
+                        GX2Flush();
+                        submitted[current] = GX2GetLastSubmittedTimeStamp();
+                        current = (current + 1) % depth;
+                    } else {
+                        stalls::draw_done();
+                        collect(current);
                     }
                     // data.print_frame_results();
                     pass = 0;
                     frame_open = false;
+                    // Leave every other frame to the render pass profiler.
+                    skip = (cfg::gpu_passes ? std::max(period, 2u) : period) - 1;
+                }
+            }
+
+
+            // Average CPU time the profiler takes from a profiled frame, over the time of
+            // an average frame.
+            float
+            get_overhead(float dt)
+                const
+            {
+                if (!profiled_frames || !total_frames)
+                    return 0;
+                float frame_time = dt / total_frames;
+                float cost = float(overhead) / OSTimerClockSpeed / profiled_frames;
+                return cost / frame_time;
+            }
+
+
+            // Called after a pause: keeps the GX2Perf data and all the history, but drops
+            // the frame that was open across the pause.
+            void
+            resume(unsigned sample_period)
+            {
+                if (frame_open)
+                    discard[current] = true;
+                auto_period = sample_period == 0;
+                if (sample_period)
+                    period = sample_period;
+                skip = 0;
+                overhead = 0;
+                profiled_frames = 0;
+                total_frames = 0;
+                interval_ended = false;
+            }
+
+
+            // Called when the HUD is hidden: closes whatever is open, and drops it, so the
+            // profiler starts with a clean frame and a fresh interval when shown again.
+            void
+            pause()
+            {
+                skipping = false;
+                started = false;
+                interval_ended = true;
+                if (!frame_open)
+                    return;
+
+                auto& data = *ring[current];
+                if (pass_open) {
+                    data.tag_finish(0);
+                    data.pass_finish();
+                    pass_open = false;
+                }
+                data.frame_finish();
+                discard[current] = true;
+                if (pipelined) {
+                    GX2Flush();
+                    submitted[current] = GX2GetLastSubmittedTimeStamp();
+                    current = (current + 1) % depth;
+                } else
+                    stalls::draw_done();
+                pass = 0;
+                frame_open = false;
+            }
+
+
+            // Picks the smallest period that keeps the overhead under budget. Every
+            // report calls this, so the counters are only reset on the next frame.
+            void
+            end_interval(float dt)
+            {
+                const float overhead_budget = 0.005f;
+                const unsigned max_period = 60;
+
+                if (interval_ended)
+                    return;
+                interval_ended = true;
+
+                if (auto_period && profiled_frames) {
+                    float ratio = get_overhead(dt) / overhead_budget;
+                    period = std::clamp<unsigned>(std::ceil(ratio), 1, max_period);
                 }
             }
 
@@ -571,6 +1069,60 @@ namespace gx2_mon {
         std::optional<profiler> prof;
 
 
+        /*
+         * A/B test of the readback modes: the profiler switches between synchronous and
+         * pipelined readback every few hundred frames, and the frame rate measured with
+         * each mode is shown next to the GPU utilization. The configured mode comes back
+         * on the next reset.
+         */
+        namespace ab_test {
+
+            const unsigned frames_per_run = 600;
+
+            unsigned frames = 0;
+            OSTime run_start = 0;
+            // Frame rate of the last run with each mode; 0 until measured.
+            float fps_sync = 0;
+            float fps_pipelined = 0;
+
+
+            void
+            reset()
+            {
+                frames = 0;
+                run_start = 0;
+                fps_sync = 0;
+                fps_pipelined = 0;
+            }
+
+
+            void
+            on_frame_finish()
+            {
+                OSTime now = OSGetSystemTime();
+                if (!run_start)
+                    run_start = now;
+
+                if (++frames < frames_per_run || prof->frame_open)
+                    return;
+
+                const bool pipelined = prof->pipelined;
+                const float fps = frames / (float(now - run_start) / OSTimerClockSpeed);
+                (pipelined ? fps_pipelined : fps_sync) = fps;
+                logger::printf("A/B readback: %s = %.2f fps (%u late results)\n",
+                               pipelined ? "pipelined" : "synchronous",
+                               fps,
+                               prof->late_results);
+                frames = 0;
+                run_start = now;
+
+                prof.reset();
+                prof.emplace(!pipelined, cfg::gpu_sample_period);
+            }
+
+        } // namespace ab_test
+
+
         void
         initialize()
         {
@@ -580,7 +1132,7 @@ namespace gx2_mon {
             // initialize_lmm_heap();
 
             // TRACE;
-            prof.emplace();
+            prof.emplace(cfg::gpu_busy_pipelined, cfg::gpu_sample_period);
         }
 
 
@@ -596,76 +1148,1588 @@ namespace gx2_mon {
         }
 
 
+        // Warm restart: the profiler is only created again if the readback mode changed.
         void
-        on_frame_start()
+        resume()
         {
-            if (prof)
-                prof->start_frame();
+            ab_test::reset();
+            if (prof && prof->pipelined != cfg::gpu_busy_pipelined)
+                finalize();
+            if (!prof) {
+                initialize();
+                return;
+            }
+            prof->resume(cfg::gpu_sample_period);
         }
 
 
         void
-        on_frame_finish()
+        pause()
         {
             if (prof)
-                prof->finish_frame();
+                prof->pause();
+        }
+
+
+        void
+        on_frame_start()
+        {
+            if (!prof)
+                return;
+
+            OSTime start = OSGetSystemTime();
+            prof->start_frame();
+            prof->overhead += OSGetSystemTime() - start;
         }
 
 
-        template<std::ranges::forward_range R>
-        auto
-        average(R&& seq)
+        void
+        on_frame_finish()
         {
-            using T = std::ranges::range_value_t<R>;
-            T sum = T{0};
-            unsigned num = 0;
-            for (const auto& x : seq) {
-                sum += x;
-                ++num;
+            if (prof) {
+                OSTime start = OSGetSystemTime();
+                prof->finish_frame();
+                prof->overhead += OSGetSystemTime() - start;
+                if (cfg::gpu_busy_ab_test)
+                    ab_test::on_frame_finish();
             }
-            return sum / num;
         }
 
 
         const char*
-        get_report(float /*dt*/)
+        get_report(float dt)
         {
             if (!prof)
                 return "";
 
-            float avg_gpu_busy = average(prof->gpu_busy_vec);
-            unsigned n_samples = prof->gpu_busy_vec.size();
-            prof->gpu_busy_vec.clear();
+            const auto gpu_busy = prof->gpu_busy_stats.take();
+            const float avg_gpu_busy = gpu_busy.mean;
+            const unsigned n_samples = gpu_busy.count;
+            const float conf = gpu_busy.confidence();
+
+            const unsigned period = prof->period;
+            const float overhead = 100 * prof->get_overhead(dt);
+            prof->end_interval(dt);
 
             if (n_samples == 0)
                 return "GPU: ?";
 
-            static char buf[16];
+            static char buf[112];
+            int len;
             if (cfg::gpu_busy_percent)
-                std::snprintf(buf, sizeof buf,
-                              "GPU: %2.0f%%",
-                              avg_gpu_busy);
+                len = std::snprintf(buf, sizeof buf,
+                                    "GPU: %2.0f%%",
+                                    avg_gpu_busy);
             else
-                std::snprintf(buf, sizeof buf,
-                              "GPU: %s",
-                              utils::percent_to_bar(avg_gpu_busy));
+                len = std::snprintf(buf, sizeof buf,
+                                    "GPU: %s",
+                                    utils::percent_to_bar(avg_gpu_busy));
+
+            // When sampling, show how much to trust the result, and what it costs.
+            if (period > 1 && len > 0 && unsigned(len) < sizeof buf)
+                len += std::snprintf(buf + len, sizeof buf - len,
+                                     " ±%.0f (1/%u, n=%u, %.1f%%)",
+                                     conf, period, n_samples, overhead);
+
+            if (cfg::gpu_busy_ab_test && len > 0 && unsigned(len) < sizeof buf)
+                std::snprintf(buf + len, sizeof buf - len,
+                              " A/B: sync %.1f, pipelined %.1f fps",
+                              ab_test::fps_sync, ab_test::fps_pipelined);
 
             return buf;
         }
 
-    } // namespace perf
 
+        // Memory traffic per profiled frame, times the frame rate.
+        const char*
+        get_bandwidth_report(float dt)
+        {
+            if (!prof)
+                return "";
 
-    namespace fps {
+            const unsigned frames = prof->bandwidth_frames;
+            const float tex_bytes = prof->tex_bytes_read;
+            const float cb_bytes = float(prof->cb_pixels_written) * cb_bytes_per_pixel;
+            prof->tex_bytes_read = 0;
+            prof->cb_pixels_written = 0;
+            prof->bandwidth_frames = 0;
 
-        unsigned counter = 0;
+            const unsigned total_frames = prof->total_frames;
+            prof->end_interval(dt);
 
+            if (!frames || !total_frames)
+                return "MEM: ?";
 
-        void
-        initialize()
-        {
-            counter = 0;
-        }
+            const float fps = total_frames / dt;
+            const float tex_gbps = tex_bytes / frames * fps / 1e9f;
+            const float cb_gbps = cb_bytes / frames * fps / 1e9f;
+
+            static char buf[48];
+            std::snprintf(buf, sizeof buf,
+                          "MEM: %.1f GB/s (TEX %.1f, CB %.1f)",
+                          tex_gbps + cb_gbps, tex_gbps, cb_gbps);
+            return buf;
+        }
+
+
+        const char*
+        get_stages_report(float dt)
+        {
+            if (!prof)
+                return "";
+
+            prof->end_interval(dt);
+
+            static char buf[96];
+            unsigned pos = 0;
+            buf[0] = '\0';
+            for (unsigned i = 0; i < stage_metrics.size(); ++i) {
+                auto& stats = prof->stage_stats[i];
+                if (!stats.count)
+                    continue;
+                if (pos < sizeof buf)
+                    pos += std::snprintf(buf + pos, sizeof buf - pos,
+                                         "%s%s %.0f%%",
+                                         pos ? " " : "",
+                                         stage_metrics[i].label,
+                                         stats.mean);
+                stats.clear();
+            }
+
+            if (!pos)
+                return "GPU stages: ?";
+
+            return buf;
+        }
+
+    } // namespace perf
+
+
+    /*
+     * Render pass timing
+     *
+     * Every time the game binds a different color buffer to target 0, a new render pass
+     * starts. Each pass gets its own GX2Perf tag (its index in the frame), collected with
+     * GX2_PERF_COLLECT_TAGS_INDIVIDUAL. Only GPU_TIME is enabled, so a frame always fits in
+     * a single pass.
+     *
+     * GX2Perf can only collect one thing at a time, so this only profiles the frames the
+     * utilization profiler skips.
+     */
+    namespace passes {
+
+        const unsigned max_passes = 32;
+        const unsigned depth = 2;
+        const unsigned top_n = 3;
+
+        // GX2PerfInit() allocates blocks proportional to the number of tags; with
+        // max_passes tags they go in the pool's largest class.
+        bool ready = false;
+        MEMAllocator allocator;
+
+        struct pass_info {
+            std::uint16_t width;
+            std::uint16_t height;
+        };
+
+        struct slot {
+            std::optional<gx2::perf_data> data;
+            // Timestamp of the submission that ended this slot's frame; 0 if none.
+            OSTime submitted;
+            unsigned num_passes;
+            std::array<pass_info, max_passes> info;
+            // Open while paused, so the results are meaningless.
+            bool discard;
+        };
+
+        std::array<slot, depth> ring;
+        unsigned current = 0;
+        bool frame_open = false;
+        bool tag_open = false;
+        const GX2ColorBuffer* last_buffer = nullptr;
+        // Core of the thread that swaps; only its color buffers get tagged, since the
+        // rest of this state belongs to it.
+        std::atomic_uint32_t swap_core = ~0u;
+
+        struct pass_stats {
+            std::uint64_t time;
+            pass_info     info;
+        };
+
+        std::array<pass_stats, max_passes> stats;
+        std::uint64_t total_time = 0;
+        unsigned frames = 0;
+        unsigned late_results = 0;
+
+
+        void
+        initialize()
+        {
+            if (ready || !lmm_ptr)
+                return;
+
+            allocator = libmappedmemory_allocator();
+            const unsigned failures = lmm_alloc_failures;
+            for (auto& s : ring) {
+                auto& data = s.data.emplace(max_passes, allocator);
+                data.set_collection_method(GX2_PERF_COLLECT_TAGS_INDIVIDUAL);
+                data.enable_all_tags();
+                data.clear_metrics();
+                data.enable_metric(GX2_PERF_U64_GPU_TIME);
+                s.submitted = 0;
+                s.num_passes = 0;
+                s.discard = false;
+            }
+            if (lmm_alloc_failures != failures) {
+                logger::printf("Failed to allocate memory for render pass profiling.\n");
+                for (auto& s : ring)
+                    s.data.reset();
+                return;
+            }
+            ready = true;
+
+            current = 0;
+            frame_open = false;
+            tag_open = false;
+            last_buffer = nullptr;
+            stats = {};
+            total_time = 0;
+            frames = 0;
+            late_results = 0;
+        }
+
+
+        void
+        finalize()
+        {
+            if (!ready)
+                return;
+
+            // Don't free anything the GPU might still write into.
+            for (auto& s : ring)
+                if (s.submitted) {
+                    stalls::draw_done();
+                    break;
+                }
+
+            for (auto& s : ring)
+                s.data.reset();
+            frame_open = false;
+            tag_open = false;
+            ready = false;
+        }
+
+
+        void
+        collect(slot& s)
+        {
+            s.submitted = 0;
+
+            if (s.discard) {
+                s.discard = false;
+                return;
+            }
+
+            for (unsigned seq = 0; ; ++seq) {
+                auto res = s.data->get_tag_sequence_result(GX2_PERF_U64_GPU_TIME, seq);
+                if (!res)
+                    break;
+                if (res->tag >= s.num_passes)
+                    continue;
+                std::uint64_t time = std::get<std::uint64_t>(res->result);
+                auto& st = stats[res->tag];
+                st.time += time;
+                st.info = s.info[res->tag];
+                total_time += time;
+            }
+            ++frames;
+        }
+
+
+        void
+        on_frame_start()
+        {
+            if (!ready)
+                return;
+
+            // Only one GX2Perf collection can be running.
+            if (perf::prof && perf::prof->frame_open)
+                return;
+
+            slot& s = ring[current];
+            if (s.submitted) {
+                if (GX2GetRetiredTimeStamp() >= s.submitted)
+                    collect(s);
+                else {
+                    ++late_results;
+                    s.submitted = 0;
+                }
+            }
+
+            swap_core.store(OSGetCoreId(), std::memory_order_relaxed);
+            s.num_passes = 0;
+            last_buffer = nullptr;
+            s.data->frame_start();
+            s.data->pass_start();
+            frame_open = true;
+        }
+
+
+        void
+        on_frame_finish()
+        {
+            if (!frame_open)
+                return;
+
+            slot& s = ring[current];
+            if (tag_open) {
+                s.data->tag_finish(s.num_passes - 1);
+                tag_open = false;
+            }
+            s.data->pass_finish();
+            s.data->frame_finish();
+            frame_open = false;
+
+            GX2Flush();
+            s.submitted = GX2GetLastSubmittedTimeStamp();
+            current = (current + 1) % depth;
+        }
+
+
+        // Closes the open frame, and drops it.
+        void
+        pause()
+        {
+            if (!frame_open)
+                return;
+            ring[current].discard = true;
+            on_frame_finish();
+        }
+
+
+        // Called when the game binds a color buffer.
+        void
+        on_set_color_buffer(const GX2ColorBuffer* buffer,
+                            GX2RenderTarget target)
+        {
+            if (OSGetCoreId() != swap_core.load(std::memory_order_relaxed))
+                return;
+            // Commands going into a display list run whenever the game submits it, not
+            // in this pass.
+            if (GX2GetDisplayListWriteStatus())
+                return;
+            if (!frame_open || target != GX2_RENDER_TARGET_0 || buffer == last_buffer)
+                return;
+            last_buffer = buffer;
+
+            slot& s = ring[current];
+            if (tag_open) {
+                s.data->tag_finish(s.num_passes - 1);
+                tag_open = false;
+            }
+            // Passes beyond the limit get merged into the last one.
+            if (s.num_passes >= max_passes || !buffer)
+                return;
+
+            s.info[s.num_passes] = {
+                static_cast<std::uint16_t>(buffer->surface.width),
+                static_cast<std::uint16_t>(buffer->surface.height)
+            };
+            s.data->tag_start(s.num_passes);
+            ++s.num_passes;
+            tag_open = true;
+        }
+
+
+        const char*
+        get_report(float /*dt*/)
+        {
+            if (!ready)
+                return "";
+
+            if (!frames || !total_time)
+                return "Passes: ?";
+
+            std::array<unsigned, max_passes> order;
+            for (unsigned i = 0; i < max_passes; ++i)
+                order[i] = i;
+            const unsigned n = std::min(top_n, max_passes);
+            std::ranges::partial_sort(order,
+                                      order.begin() + n,
+                                      std::ranges::greater{},
+                                      [](unsigned i) { return stats[i].time; });
+
+            static char buf[96];
+            int pos = std::snprintf(buf, sizeof buf, "Passes:");
+            for (unsigned i = 0; i < n; ++i) {
+                const auto& st = stats[order[i]];
+                if (!st.time)
+                    break;
+                if (pos < 0 || unsigned(pos) >= sizeof buf)
+                    break;
+                pos += std::snprintf(buf + pos, sizeof buf - pos,
+                                     " #%u %ux%u %.0f%%",
+                                     order[i],
+                                     st.info.width,
+                                     st.info.height,
+                                     100.0 * st.time / total_time);
+            }
+
+            stats = {};
+            total_time = 0;
+            frames = 0;
+            return buf;
+        }
+
+
+        // Warm restart: keeps the GX2Perf data, but drops the frame that was open while
+        // paused.
+        void
+        resume()
+        {
+            if (!ready) {
+                initialize();
+                return;
+            }
+            if (frame_open)
+                ring[current].discard = true;
+        }
+
+    } // namespace passes
+
+
+    /*
+     * GPU timing through timestamps
+     *
+     * This is a much lighter alternative to GX2Perf: every frame gets a top-of-pipe
+     * timestamp when it starts, and a bottom-of-pipe timestamp when it finishes. They're
+     * only read back `depth` frames later, when the GPU is long done with them.
+     *
+     * The GPU is busy with a frame from the moment it starts it (or finishes the
+     * previous one, if later), until its bottom timestamp.
+     */
+    namespace timing {
+
+        // The GPU timestamp counter runs at 27 MHz.
+        const float gpu_cycles_per_ms = 27000.0f;
+
+        const unsigned depth = 4;
+
+        // One cache line per frame, so each can be flushed/invalidated on its own.
+        struct alignas(32) frame_stamps {
+            std::uint64_t top;
+            std::uint64_t bottom;
+        };
+
+        // Lives in mapped memory, so the GPU can write into it.
+        frame_stamps* ring = nullptr;
+        unsigned current = 0;
+        bool frame_open = false;
+        std::uint64_t last_bottom = 0;
+
+        std::uint64_t busy_cycles = 0;
+        std::uint64_t total_cycles = 0;
+        unsigned frames = 0;
+        unsigned late_frames = 0;
+        // Frames that were open while paused.
+        std::array<bool, depth> discard{};
+        // Slots the GPU has yet to write both timestamps into.
+        std::array<bool, depth> pending{};
+        // Pending slots already counted in late_frames.
+        std::array<bool, depth> late{};
+
+
+        void
+        initialize()
+        {
+            if (ring)
+                return;
+
+            ring = static_cast<frame_stamps*>(
+                       MEMAllocFromMappedMemoryForGX2Ex(depth * sizeof(frame_stamps),
+                                                        alignof(frame_stamps)));
+            if (!ring) {
+                logger::printf("Failed to allocate memory for GPU timestamps.\n");
+                return;
+            }
+            for (unsigned i = 0; i < depth; ++i)
+                ring[i] = {};
+            DCFlushRange(ring, depth * sizeof(frame_stamps));
+
+            current = 0;
+            frame_open = false;
+            last_bottom = 0;
+            busy_cycles = 0;
+            total_cycles = 0;
+            frames = 0;
+            late_frames = 0;
+            discard = {};
+            pending = {};
+            late = {};
+        }
+
+
+        // Warm restart: the frame open while paused spans the whole pause, so it's
+        // dropped.
+        void
+        resume()
+        {
+            if (!ring) {
+                initialize();
+                return;
+            }
+            if (frame_open)
+                discard[current] = true;
+        }
+
+
+        void
+        finalize()
+        {
+            if (!ring)
+                return;
+
+            // Don't free anything the GPU might still write into.
+            stalls::draw_done();
+            MEMFreeToMappedMemory(ring);
+            ring = nullptr;
+        }
+
+
+        // Returns false if the GPU still hasn't written the slot's timestamps, so it
+        // can't be reused yet.
+        bool
+        collect(unsigned slot)
+        {
+            if (!pending[slot])
+                return true;
+
+            frame_stamps& stamps = ring[slot];
+            DCInvalidateRange(&stamps, sizeof stamps);
+
+            // The GPU is more than `depth` frames behind; skip timing frames until it
+            // catches up.
+            if (!stamps.top || !stamps.bottom) {
+                if (!late[slot]) {
+                    late[slot] = true;
+                    ++late_frames;
+                }
+                last_bottom = 0;
+                return false;
+            }
+
+            pending[slot] = false;
+
+            if (discard[slot] || late[slot]) {
+                discard[slot] = false;
+                late[slot] = false;
+                last_bottom = 0;
+                return true;
+            }
+
+            if (last_bottom) {
+                std::uint64_t begin = std::max(stamps.top, last_bottom);
+                if (stamps.bottom > begin)
+                    busy_cycles += stamps.bottom - begin;
+                if (stamps.bottom > last_bottom)
+                    total_cycles += stamps.bottom - last_bottom;
+                ++frames;
+            }
+            last_bottom = stamps.bottom;
+            return true;
+        }
+
+
+        void
+        on_frame_start()
+        {
+            if (!ring)
+                return;
+
+            if (!collect(current))
+                return;
+            frame_stamps& stamps = ring[current];
+
+            stamps = {};
+            DCFlushRange(&stamps, sizeof stamps);
+            GX2SampleTopGPUCycle(&stamps.top);
+            pending[current] = true;
+            frame_open = true;
+        }
+
+
+        void
+        on_frame_finish()
+        {
+            if (!ring || !frame_open)
+                return;
+
+            GX2SampleBottomGPUCycle(&ring[current].bottom);
+            current = (current + 1) % depth;
+            frame_open = false;
+        }
+
+
+        // Closes the open frame, and drops it.
+        void
+        pause()
+        {
+            if (!frame_open)
+                return;
+            discard[current] = true;
+            on_frame_finish();
+        }
+
+
+        const char*
+        get_report(float /*dt*/)
+        {
+            if (!ring)
+                return "";
+
+            if (!frames || !total_cycles)
+                return "GPU time: ?";
+
+            float frame_ms = busy_cycles / gpu_cycles_per_ms / frames;
+            float busy = 100.0f * busy_cycles / total_cycles;
+            busy_cycles = 0;
+            total_cycles = 0;
+            frames = 0;
+
+            static char buf[40];
+            if (cfg::gpu_busy_percent)
+                std::snprintf(buf, sizeof buf,
+                              "GPU time: %.1f ms %2.0f%%",
+                              frame_ms, busy);
+            else
+                std::snprintf(buf, sizeof buf,
+                              "GPU time: %.1f ms %s",
+                              frame_ms, utils::percent_to_bar(busy));
+            return buf;
+        }
+
+    } // namespace timing
+
+
+    /*
+     * Bottleneck classification
+     *
+     * When the GPU is busy most of the time, the game is GPU-bound, and the busiest group
+     * of stages tells which part of the GPU is the limit. Otherwise the average frame time
+     * is compared against the frame budget (the swap interval, in vsyncs): frames on time
+     * mean the game is just waiting for vsync. Late frames are CPU-bound when the CPU
+     * work outside `GX2SwapScanBuffers()` takes most of the budget, and GPU-bound when
+     * the time went into waiting inside the swap.
+     */
+    namespace bottleneck {
+
+        // GPU_BUSY above this means GPU-bound.
+        const float gpu_bound_threshold = 85.0f;
+
+        // The Wii U scans out at 59.94 Hz (the 50 Hz 576i mode is ignored). The frame
+        // budget is the swap interval times this.
+        const float vsync_period_ms = 1000 / 59.94f;
+
+        // Frames up to this much over the budget still count as on time.
+        const float budget_slack = 1.05f;
+
+        // When frames are late, CPU work above this fraction of the budget means
+        // CPU-bound; below it, the frame was lost waiting on the GPU.
+        const float cpu_bound_threshold = 0.9f;
+
+        enum class group : unsigned {
+            vertex,
+            pixel,
+            texture,
+            raster,
+        };
+
+        const char* const group_labels[] = {
+            "VTX",
+            "PIX",
+            "TEX",
+            "RAS",
+        };
+
+        // Which group each entry in perf::stage_metrics belongs to.
+        const std::array<group, perf::stage_metrics.size()> stage_groups{
+            group::vertex,      // VS
+            group::pixel,       // PS
+            group::pixel,       // ALU
+            group::texture,     // TEX
+            group::vertex,      // PA
+            group::raster,      // RAS
+            group::raster,      // DB
+            group::raster,      // ROP
+        };
+
+        perf::metric_stats gpu_busy;
+        std::array<perf::metric_stats, perf::stage_metrics.size()> stages;
+        OSTime swap_wait = 0;
+        unsigned frames = 0;
+
+
+        void
+        reset()
+        {
+            gpu_busy = {};
+            stages = {};
+            swap_wait = 0;
+            frames = 0;
+        }
+
+
+        void
+        add_gpu_busy(float sample)
+        {
+            gpu_busy.add(sample);
+        }
+
+
+        void
+        add_stage(unsigned stage, float sample)
+        {
+            stages[stage].add(sample);
+        }
+
+
+        void
+        on_swap(OSTime enter, OSTime leave)
+        {
+            swap_wait += leave - enter;
+            ++frames;
+        }
+
+
+        const char*
+        get_report(float dt)
+        {
+            static char buf[32];
+
+            const float busy = gpu_busy.count ? gpu_busy.mean : -1;
+
+            // Average frame time, and the part of it the CPU spent outside the swap.
+            const float frame_ms = frames ? dt * 1000 / frames : 0;
+            const float wait_ms = swap_wait * 1000.0f / OSTimerClockSpeed;
+            const float cpu_ms = frames
+                                 ? std::max(dt * 1000 - wait_ms, 0.0f) / frames
+                                 : 0;
+            // With no swap interval there's no vsync, so no budget either.
+            const float budget_ms = GX2GetSwapInterval() * vsync_period_ms;
+            const bool late = !budget_ms || frame_ms > budget_ms * budget_slack;
+
+            // Average busy % of each group, using its busiest stage.
+            std::array<float, std::size(group_labels)> groups{};
+            bool have_stages = false;
+            for (unsigned i = 0; i < stages.size(); ++i) {
+                if (!stages[i].count)
+                    continue;
+                have_stages = true;
+                float avg = stages[i].mean;
+                auto& g = groups[static_cast<unsigned>(stage_groups[i])];
+                g = std::max(g, avg);
+            }
+            const unsigned num_frames = frames;
+            reset();
+
+            if (busy < 0 || !num_frames)
+                return "GPU: ?";
+
+            // A late frame spent mostly waiting on the GPU is GPU-bound too, even if the
+            // GPU wasn't busy the whole time.
+            if (busy >= gpu_bound_threshold
+                || (late && budget_ms && cpu_ms < budget_ms * cpu_bound_threshold)) {
+                if (!have_stages) {
+                    std::snprintf(buf, sizeof buf, "GPU-bound %.0f%%", busy);
+                    return buf;
+                }
+                auto top = std::ranges::max_element(groups);
+                std::snprintf(buf, sizeof buf,
+                              "GPU:%s-bound %.0f%%",
+                              group_labels[top - groups.begin()],
+                              *top);
+                return buf;
+            }
+
+            // On time: the game waits for vsync, using this much of the budget.
+            if (!late) {
+                std::snprintf(buf, sizeof buf,
+                              "VSYNC-bound %.0f%%",
+                              100 * cpu_ms / budget_ms);
+                return buf;
+            }
+
+            if (budget_ms)
+                std::snprintf(buf, sizeof buf,
+                              "CPU-bound %.1f/%.1f ms",
+                              cpu_ms, budget_ms);
+            else
+                std::snprintf(buf, sizeof buf, "CPU-bound %.1f ms", cpu_ms);
+            return buf;
+        }
+
+    } // namespace bottleneck
+
+
+    /*
+     * CPU work vs. swap wait
+     *
+     * The time from leaving one swap to entering the next is the game's CPU work for a
+     * frame; the time spent inside the swap is back-pressure from the GPU (or vsync).
+     */
+    namespace frame_split {
+
+        // In milliseconds, since the last report.
+        utils::running_stats work;
+        utils::running_stats wait;
+
+        OSTime last_leave = 0;
+
+
+        void
+        reset()
+        {
+            work.clear();
+            wait.clear();
+            last_leave = 0;
+        }
+
+
+        // Warm restart: drops the time spent paused.
+        void
+        resume()
+        {
+            reset();
+        }
+
+
+        void
+        on_swap(OSTime enter, OSTime leave)
+        {
+            if (last_leave) {
+                work.add(OSTicksToMicroseconds(enter - last_leave) / 1000.0f);
+                wait.add(OSTicksToMicroseconds(leave - enter) / 1000.0f);
+            }
+            last_leave = leave;
+        }
+
+
+        const char*
+        get_report(float /*dt*/)
+        {
+            const auto work_stats = work.take();
+            const auto wait_stats = wait.take();
+            if (!work_stats.count)
+                return "CPU: ?";
+
+            static char buf[48];
+            std::snprintf(buf, sizeof buf,
+                          "CPU %.1f ms (max %.1f) / wait %.1f ms",
+                          work_stats.mean, work_stats.max, wait_stats.mean);
+            return buf;
+        }
+
+    } // namespace frame_split
+
+
+    /*
+     * CPU stalls on the GPU
+     *
+     * Waiting on a fence, for the GPU to be done, or to lock a GX2R resource the GPU is
+     * still using, all block the CPU. These can be called from any thread, so everything
+     * is accumulated in atomics, in microseconds; a stall doesn't also wait on a lock.
+     *
+     * Each call site is identified by its return address; the first call sites seen get a
+     * slot in a small table, and stalls from call sites that don't fit are only counted
+     * in the totals. The sites' times are reset on every report, like the totals, and a
+     * slot that had no stalls in the last interval is freed for a new call site.
+     */
+    namespace stalls {
+
+        enum kind : unsigned {
+            wait_timestamp,
+            draw_done_call,
+            lock_buffer,
+            lock_surface,
+            num_kinds
+        };
+
+        const char* const kind_labels[num_kinds] = {
+            "WaitTS",
+            "DrawDone",
+            "LockBuf",
+            "LockSurf",
+        };
+
+        // Instructions are 4-byte aligned, so the kind goes in the return address' low
+        // bits.
+        static_assert(num_kinds <= 4);
+        const std::uint32_t kind_mask = 3;
+
+        struct call_site {
+            // Return address and kind; 0 if the slot is free.
+            std::atomic_uint32_t key{0};
+            std::atomic_uint32_t total{0};
+        };
+
+        const unsigned max_sites = 16;
+        const unsigned top_n = 2;
+
+        std::atomic_uint32_t count{0};
+        std::atomic_uint32_t total{0};
+        // Duration, with the kind in the low bits.
+        std::atomic_uint32_t worst{0};
+        std::array<call_site, max_sites> sites;
+
+
+        void
+        reset()
+        {
+            count = 0;
+            total = 0;
+            worst = 0;
+            for (auto& site : sites) {
+                site.key = 0;
+                site.total = 0;
+            }
+        }
+
+
+        void
+        add(kind type,
+            const void* caller,
+            OSTime enter,
+            OSTime leave)
+        {
+            // Clamped, so it can be shifted for the worst stall.
+            const std::uint32_t t = std::min<OSTime>(OSTicksToMicroseconds(leave - enter),
+                                                     ~std::uint32_t{0} >> 2);
+            const auto addr = reinterpret_cast<std::uintptr_t>(caller);
+            const std::uint32_t key = static_cast<std::uint32_t>(addr) | type;
+
+            count.fetch_add(1, std::memory_order_relaxed);
+            total.fetch_add(t, std::memory_order_relaxed);
+
+            const std::uint32_t packed = t << 2 | type;
+            std::uint32_t old_worst = worst.load(std::memory_order_relaxed);
+            while (packed > old_worst
+                   && !worst.compare_exchange_weak(old_worst, packed,
+                                                   std::memory_order_relaxed))
+                ;
+
+            for (auto& site : sites) {
+                std::uint32_t k = site.key.load(std::memory_order_relaxed);
+                if (!k && site.key.compare_exchange_strong(k, key,
+                                                           std::memory_order_relaxed))
+                    k = key;
+                if (k == key) {
+                    site.total.fetch_add(t, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        }
+
+
+        const char*
+        get_report(float /*dt*/)
+        {
+            static char buf[128];
+
+            const std::uint32_t n = count.exchange(0, std::memory_order_relaxed);
+            const std::uint32_t t = total.exchange(0, std::memory_order_relaxed);
+            const std::uint32_t w = worst.exchange(0, std::memory_order_relaxed);
+
+            int len = std::snprintf(buf, sizeof buf,
+                                    "Stalls: %u %.1f ms",
+                                    static_cast<unsigned>(n),
+                                    t / 1000.0f);
+            if (w && len > 0 && unsigned(len) < sizeof buf)
+                len += std::snprintf(buf + len, sizeof buf - len,
+                                     " (max %.1f %s)",
+                                     (w >> 2) / 1000.0f,
+                                     kind_labels[w & kind_mask]);
+
+            struct site_total {
+                std::uint32_t key;
+                std::uint32_t total;
+            };
+            std::array<site_total, max_sites> sorted;
+            for (unsigned i = 0; i < max_sites; ++i) {
+                auto& site = sites[i];
+                std::uint32_t key = site.key.load(std::memory_order_relaxed);
+                const std::uint32_t t_site =
+                    site.total.exchange(0, std::memory_order_relaxed);
+                // A stall racing with this only gets its time credited to the slot's
+                // next owner.
+                if (key && !t_site)
+                    site.key.compare_exchange_strong(key, 0, std::memory_order_relaxed);
+                sorted[i] = {key, t_site};
+            }
+            std::ranges::partial_sort(sorted,
+                                      sorted.begin() + top_n,
+                                      std::ranges::greater{},
+                                      &site_total::total);
+            for (unsigned i = 0; i < top_n; ++i) {
+                const auto& site = sorted[i];
+                if (!site.total || len < 0 || unsigned(len) >= sizeof buf)
+                    break;
+                len += std::snprintf(buf + len, sizeof buf - len,
+                                     " %s@%08x %.1f ms",
+                                     kind_labels[site.key & kind_mask],
+                                     static_cast<unsigned>(site.key & ~kind_mask),
+                                     site.total / 1000.0f);
+            }
+
+            return buf;
+        }
+
+    } // namespace stalls
+
+
+    /*
+     * GPU resource memory
+     *
+     * Every surface and buffer GX2R allocates is recorded, keyed by the pointer to its
+     * descriptor, with the size GX2 calculated for it. The heap is told apart by the
+     * address: MEM1 is the 32 MiB of fast embedded memory; anything else is MEM2.
+     *
+     * Resources are tracked even when not shown, so the totals are right when the option
+     * gets enabled.
+     */
+    namespace vram {
+
+        const std::uintptr_t mem1_begin = 0xf4000000;
+        const std::uint32_t mem1_size = 32 * 1024 * 1024;
+
+        struct resource {
+            std::uint32_t size;
+            bool          mem1;
+        };
+
+        std::mutex mut;
+        // Note: static storage, the hooks never allocate.
+        utils::ptr_map<resource, 4096> resources;
+        std::uint64_t mem1_used = 0;
+        std::uint64_t mem2_used = 0;
+        std::uint64_t mem1_peak = 0;
+        unsigned untracked = 0;
+
+
+        bool
+        is_mem1(const void* ptr)
+        {
+            auto addr = reinterpret_cast<std::uintptr_t>(ptr);
+            return addr >= mem1_begin && addr - mem1_begin < mem1_size;
+        }
+
+
+        void
+        clear()
+        {
+            std::lock_guard lock{mut};
+            resources.clear();
+            mem1_used = 0;
+            mem2_used = 0;
+            mem1_peak = 0;
+            untracked = 0;
+        }
+
+
+        void
+        add(const void* key,
+            const void* memory,
+            std::uint32_t size)
+        {
+            resource res{size, is_mem1(memory)};
+
+            std::lock_guard lock{mut};
+            if (resources.find(key)) {
+                // Created again without being destroyed; forget the old one.
+                resource old = *resources.erase(key);
+                (old.mem1 ? mem1_used : mem2_used) -= old.size;
+            }
+            if (!resources.insert(key, res)) {
+                if (!untracked++)
+                    logger::printf("Too many GX2R resources, some are not tracked.\n");
+                return;
+            }
+            if (res.mem1) {
+                mem1_used += size;
+                mem1_peak = std::max(mem1_peak, mem1_used);
+            } else
+                mem2_used += size;
+        }
+
+
+        void
+        remove(const void* key)
+        {
+            std::lock_guard lock{mut};
+            auto res = resources.erase(key);
+            if (!res)
+                return;
+            (res->mem1 ? mem1_used : mem2_used) -= res->size;
+        }
+
+
+        const char*
+        get_report(float /*dt*/)
+        {
+            const float mib = 1024.0f * 1024.0f;
+
+            static char buf[64];
+            std::lock_guard lock{mut};
+            std::snprintf(buf, sizeof buf,
+                          "VRAM: %.1f/%.0f MiB MEM1 (max %.1f), %.1f MiB MEM2%s",
+                          mem1_used / mib,
+                          mem1_size / mib,
+                          mem1_peak / mib,
+                          mem2_used / mib,
+                          untracked ? "+" : "");
+            return buf;
+        }
+
+    } // namespace vram
+
+
+    /*
+     * Presentation tracking
+     *
+     * A swap only queues a flip; the flip itself happens on a later vsync. By remembering
+     * when each swap was issued, and reading back the flip count and time from
+     * `GX2GetSwapStatus()`, we know how long it took to reach the screen, and how many
+     * vsyncs were missed between flips, beyond the swap interval.
+     *
+     * The game's own calls to `GX2GetSwapStatus()` are also used as extra sample points,
+     * and the time it spends in `GX2WaitForFlip()` and `GX2WaitForVsync()` is accumulated.
+     * Those can come from any thread, so they only post their samples: the status goes
+     * through a seqlock, the wait times through SPSC sample rings. Everything else
+     * belongs to the thread that swaps, so nothing on the swap path takes a lock.
+     */
+    namespace present {
+
+        // Both the TV and the DRC refresh at 59.94 Hz.
+        const float vsync_rate = 59.94f;
+
+        // Swaps can't be queued much deeper than this, before GX2 blocks.
+        const unsigned max_pending = 8;
+
+        // The latest swap status read on another thread. A writer that finds it busy
+        // drops its sample, rather than waiting.
+        struct status_box {
+            // Odd while a writer is filling it in.
+            std::atomic_uint32_t seq{0};
+            std::atomic_uint32_t flip_count{0};
+            std::atomic_uint32_t flip_time_hi{0};
+            std::atomic_uint32_t flip_time_lo{0};
+        };
+
+        status_box posted;
+        std::uint32_t last_posted_seq = 0;
+
+        // In milliseconds. Pushed by whichever thread waited, drained by the swap
+        // thread; a second waiter that finds `pushing` set drops its sample, since the
+        // rings only take one producer at a time.
+        std::atomic_flag pushing = ATOMIC_FLAG_INIT;
+        utils::spsc_sample_ring<float, 64> flip_waits;
+        utils::spsc_sample_ring<float, 64> vsync_waits;
+
+        // Only touched by the swap thread.
+        std::array<OSTime, max_pending> swap_times;
+        std::uint32_t last_flip_count = 0;
+        OSTime last_flip_time = 0;
+        unsigned flips = 0;
+        unsigned missed_vsyncs = 0;
+        // Swap to flip, in milliseconds.
+        utils::running_stats latency;
+
+
+        // Calls the real GX2GetSwapStatus(), so our own reads don't go through the hook.
+        void get_swap_status(std::uint32_t* swap_count,
+                             std::uint32_t* flip_count,
+                             OSTime* flip_time,
+                             OSTime* vsync_time);
+
+
+        void
+        reset()
+        {
+            swap_times = {};
+            last_flip_count = 0;
+            last_flip_time = 0;
+            flips = 0;
+            missed_vsyncs = 0;
+            latency.clear();
+            flip_waits.clear();
+            vsync_waits.clear();
+        }
+
+
+        // Flip number K shows the image from swap number K.
+        void
+        update(std::uint32_t swap_count,
+               std::uint32_t flip_count,
+               OSTime flip_time)
+        {
+            // Posted samples can be older than what the swap thread already read.
+            if (static_cast<std::int32_t>(flip_count - last_flip_count) <= 0)
+                return;
+
+            const std::uint32_t new_flips = flip_count - last_flip_count;
+            if (last_flip_time && flip_time > last_flip_time) {
+                const float vsync_ticks = OSTimerClockSpeed / vsync_rate;
+                unsigned vsyncs = std::lround((flip_time - last_flip_time) / vsync_ticks);
+                unsigned expected = new_flips * std::max(GX2GetSwapInterval(), 1u);
+                if (vsyncs > expected)
+                    missed_vsyncs += vsyncs - expected;
+                flips += new_flips;
+            }
+
+            // Only the latest flip has a known time.
+            if (swap_count - flip_count < max_pending) {
+                OSTime swap_time = swap_times[flip_count % max_pending];
+                if (swap_time && flip_time >= swap_time)
+                    latency.add(OSTicksToMicroseconds(flip_time - swap_time) / 1000.0f);
+            }
+
+            last_flip_count = flip_count;
+            last_flip_time = flip_time;
+        }
+
+
+        // Called from any thread.
+        void
+        on_status(std::uint32_t /*swap_count*/,
+                  std::uint32_t flip_count,
+                  OSTime flip_time)
+        {
+            std::uint32_t seq = posted.seq.load(std::memory_order_relaxed);
+            if ((seq & 1)
+                || !posted.seq.compare_exchange_strong(seq, seq + 1,
+                                                       std::memory_order_relaxed))
+                return;
+            std::atomic_thread_fence(std::memory_order_release);
+            const auto time = static_cast<std::uint64_t>(flip_time);
+            posted.flip_count.store(flip_count, std::memory_order_relaxed);
+            posted.flip_time_hi.store(time >> 32, std::memory_order_relaxed);
+            posted.flip_time_lo.store(time, std::memory_order_relaxed);
+            posted.seq.store(seq + 2, std::memory_order_release);
+        }
+
+
+        // Reads the sample posted by on_status(), if there's a new one.
+        bool
+        take_posted(std::uint32_t& flip_count,
+                    OSTime& flip_time)
+        {
+            const std::uint32_t seq = posted.seq.load(std::memory_order_acquire);
+            if ((seq & 1) || seq == last_posted_seq)
+                return false;
+            flip_count = posted.flip_count.load(std::memory_order_relaxed);
+            std::uint64_t hi = posted.flip_time_hi.load(std::memory_order_relaxed);
+            std::uint64_t lo = posted.flip_time_lo.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // A writer got in while we were reading; the next swap will pick it up.
+            if (posted.seq.load(std::memory_order_relaxed) != seq)
+                return false;
+            last_posted_seq = seq;
+            flip_time = static_cast<OSTime>(hi << 32 | lo);
+            return true;
+        }
+
+
+        // Called from any thread.
+        void
+        poll()
+        {
+            std::uint32_t swap_count;
+            std::uint32_t flip_count;
+            OSTime flip_time;
+            OSTime vsync_time;
+            get_swap_status(&swap_count, &flip_count, &flip_time, &vsync_time);
+            on_status(swap_count, flip_count, flip_time);
+        }
+
+
+        // Called right after the real GX2SwapScanBuffers(), with the time it was called.
+        void
+        on_swap(OSTime enter)
+        {
+            std::uint32_t swap_count;
+            std::uint32_t flip_count;
+            OSTime flip_time;
+            OSTime vsync_time;
+            get_swap_status(&swap_count, &flip_count, &flip_time, &vsync_time);
+            swap_times[swap_count % max_pending] = enter;
+
+            // The posted sample is older, so it goes first.
+            std::uint32_t posted_flip_count;
+            OSTime posted_flip_time;
+            if (take_posted(posted_flip_count, posted_flip_time))
+                update(swap_count, posted_flip_count, posted_flip_time);
+            update(swap_count, flip_count, flip_time);
+        }
+
+
+        void
+        push_wait(utils::spsc_sample_ring<float, 64>& waits,
+                  OSTime enter,
+                  OSTime leave)
+        {
+            if (pushing.test_and_set(std::memory_order_acquire))
+                return;
+            waits.push(OSTicksToMicroseconds(leave - enter) / 1000.0f);
+            pushing.clear(std::memory_order_release);
+        }
+
+
+        void
+        on_flip_wait(OSTime enter, OSTime leave)
+        {
+            push_wait(flip_waits, enter, leave);
+        }
+
+
+        void
+        on_vsync_wait(OSTime enter, OSTime leave)
+        {
+            push_wait(vsync_waits, enter, leave);
+        }
+
+
+        const char*
+        get_report(float dt)
+        {
+            const float rate = flips / dt;
+            const float latency_ms = latency.take().mean;
+            const unsigned missed = missed_vsyncs;
+            const auto flip_stats = flip_waits.take();
+            const auto vsync_stats = vsync_waits.take();
+            const float wait_ms = (flip_stats.mean * flip_stats.count
+                                   + vsync_stats.mean * vsync_stats.count) / dt;
+            const bool waited = flip_stats.count || vsync_stats.count;
+            flips = 0;
+            missed_vsyncs = 0;
+
+            static char buf[64];
+            int len = std::snprintf(buf, sizeof buf,
+                                    "Flip: %.1f/s %.1f ms %u missed",
+                                    rate, latency_ms, missed);
+            // How long the game blocked on flips/vsyncs, per second.
+            if (waited && len > 0 && unsigned(len) < sizeof buf)
+                std::snprintf(buf + len, sizeof buf - len,
+                              " (wait %.0f ms/s)",
+                              wait_ms);
+            return buf;
+        }
+
+    } // namespace present
+
+
+    /*
+     * Draw call counters
+     *
+     * The draw and state hooks can be called from any core, so each core increments its
+     * own counters, in its own cache line. On every swap, the counters are taken and
+     * added to the totals.
+     */
+    namespace draws {
+
+        utils::sharded_counter<> draws;
+        utils::sharded_counter<> vertices;
+        utils::sharded_counter<> state_changes;
+
+        // Draws per frame.
+        utils::running_stats frame_draws;
+        std::uint64_t total_vertices = 0;
+        std::uint64_t total_state_changes = 0;
+
+
+        void
+        reset()
+        {
+            draws.clear();
+            vertices.clear();
+            state_changes.clear();
+            frame_draws.clear();
+            total_vertices = 0;
+            total_state_changes = 0;
+        }
+
+
+        void
+        add_draw(std::uint32_t num_vertices)
+        {
+            const unsigned core = OSGetCoreId();
+            draws.add(core, 1);
+            vertices.add(core, num_vertices);
+        }
+
+
+        void
+        add_state_change()
+        {
+            state_changes.add(OSGetCoreId(), 1);
+        }
+
+
+        void
+        on_frame_finish()
+        {
+            frame_draws.add(draws.take());
+            total_vertices += vertices.take();
+            total_state_changes += state_changes.take();
+        }
+
+
+        const char*
+        get_report(float /*dt*/)
+        {
+            const auto per_frame = frame_draws.take();
+            if (!per_frame.count)
+                return "Draws: ?";
+
+            float vertices = float(total_vertices) / per_frame.count;
+            float state_changes = float(total_state_changes) / per_frame.count;
+            unsigned peak = per_frame.max;
+            total_vertices = 0;
+            total_state_changes = 0;
+
+            static char buf[64];
+            std::snprintf(buf, sizeof buf,
+                          "Draws: %.0f (max %u) %.0fk vtx %.0f set",
+                          per_frame.mean, peak, vertices / 1000, state_changes);
+            return buf;
+        }
+
+    } // namespace draws
+
+
+    /*
+     * Per-target frame rate and resolution
+     *
+     * Games copy a color buffer into each scan buffer, then swap; but the TV and the DRC
+     * don't have to get a new image on every swap, nor at the same resolution. Every copy
+     * is counted per target, and the size of the source surface is kept, so resolution
+     * changes are caught too.
+     */
+    namespace targets {
+
+        struct target_stats {
+            std::atomic_uint32_t copies;
+            // Width in the high 16 bits, height in the low 16 bits.
+            std::atomic_uint32_t size;
+            std::atomic_uint32_t format;
+            std::atomic_uint32_t size_changes;
+        };
+
+        target_stats tv;
+        target_stats drc;
+
+
+        void
+        reset()
+        {
+            for (auto* t : {&tv, &drc}) {
+                t->copies = 0;
+                t->size = 0;
+                t->format = 0;
+                t->size_changes = 0;
+            }
+        }
+
+
+        void
+        add_copy(target_stats& t,
+                 const GX2Surface& surface)
+        {
+            std::uint32_t size = (surface.width << 16) | (surface.height & 0xffff);
+            std::uint32_t old_size = t.size.exchange(size, std::memory_order_relaxed);
+            if (old_size && old_size != size)
+                t.size_changes.fetch_add(1, std::memory_order_relaxed);
+            t.format.store(surface.format, std::memory_order_relaxed);
+            t.copies.fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        void
+        on_copy(const GX2ColorBuffer* buffer,
+                GX2ScanTarget target)
+        {
+            if (!buffer)
+                return;
+            if (target & GX2_SCAN_TARGET_TV)
+                add_copy(tv, buffer->surface);
+            if (target & GX2_SCAN_TARGET_DRC)
+                add_copy(drc, buffer->surface);
+        }
+
+
+        int
+        print_target(char* buf,
+                     std::size_t buf_size,
+                     const char* label,
+                     target_stats& t,
+                     float dt)
+        {
+            unsigned copies = t.copies.exchange(0, std::memory_order_relaxed);
+            unsigned changes = t.size_changes.exchange(0, std::memory_order_relaxed);
+            std::uint32_t size = t.size.load(std::memory_order_relaxed);
+            std::uint32_t format = t.format.load(std::memory_order_relaxed);
+
+            int len = std::snprintf(buf, buf_size,
+                                    "%s %.0f fps %ux%u",
+                                    label,
+                                    copies / dt,
+                                    size >> 16,
+                                    size & 0xffff);
+            if (len < 0 || unsigned(len) >= buf_size)
+                return len;
+            // The common formats are implied.
+            if (format != GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8 &&
+                format != GX2_SURFACE_FORMAT_SRGB_R8_G8_B8_A8)
+                len += std::snprintf(buf + len, buf_size - len, " fmt %x", format);
+            if (changes && len > 0 && unsigned(len) < buf_size)
+                len += std::snprintf(buf + len, buf_size - len, " (%u changes)", changes);
+            return len;
+        }
+
+
+        const char*
+        get_report(float dt)
+        {
+            static char buf[96];
+            int len = print_target(buf, sizeof buf, "TV", tv, dt);
+            if (len > 0 && unsigned(len) < sizeof buf)
+                len += std::snprintf(buf + len, sizeof buf - len, " | ");
+            if (len > 0 && unsigned(len) < sizeof buf)
+                print_target(buf + len, sizeof buf - len, "DRC", drc, dt);
+            return buf;
+        }
+
+    } // namespace targets
+
+
+    namespace fps {
+
+        unsigned counter = 0;
+
+        // The last frame times, in microseconds. The histogram always holds the same
+        // samples as this ring, so the lows are computed over a sliding window.
+        const unsigned window_size = 2048;
+        utils::sample_ring<std::uint32_t, window_size> frame_times;
+        utils::log_histogram histogram;
+        OSTime last_frame_time = 0;
+
+
+        void
+        initialize()
+        {
+            counter = 0;
+            frame_times.clear();
+            histogram.clear();
+            last_frame_time = 0;
+        }
 
 
         void
@@ -673,22 +2737,49 @@ namespace gx2_mon {
         {}
 
 
+        // Warm restart: keeps the frame times, but not the time spent paused.
+        void
+        resume()
+        {
+            counter = 0;
+            last_frame_time = 0;
+        }
+
+
         void
         on_frame_finish()
         {
             ++counter;
+
+            OSTime now = OSGetSystemTime();
+            if (last_frame_time) {
+                std::uint32_t sample = OSTicksToMicroseconds(now - last_frame_time);
+                if (frame_times.full())
+                    histogram.remove(frame_times.oldest());
+                frame_times.push(sample);
+                histogram.add(sample);
+            }
+            last_frame_time = now;
         }
 
 
         const char*
         get_report(float dt)
         {
-            static char buf[32];
+            static char buf[64];
 
             float fps = counter / dt;
             counter = 0;
 
-            std::snprintf(buf, sizeof buf, "%02.0f fps", fps);
+            if (cfg::gpu_fps_lows && histogram.count) {
+                // The 1% low is the frame rate at the 99th percentile of frame times.
+                float low_1 = 1e6f / histogram.quantile(0.99f);
+                float low_01 = 1e6f / histogram.quantile(0.999f);
+                std::snprintf(buf, sizeof buf,
+                              "%02.0f fps (1%%: %.0f, 0.1%%: %.0f)",
+                              fps, low_1, low_01);
+            } else
+                std::snprintf(buf, sizeof buf, "%02.0f fps", fps);
             return buf;
         }
 
@@ -706,10 +2797,20 @@ namespace gx2_mon {
         if (!overlay::gx2_init)
             return;
 
-        if (cfg::gpu_busy)
+        if (perf::is_wanted())
             perf::initialize();
+        if (cfg::gpu_passes)
+            passes::initialize();
+        bottleneck::reset();
+        if (cfg::gpu_time)
+            timing::initialize();
         if (cfg::gpu_fps)
             fps::initialize();
+        draws::reset();
+        present::reset();
+        targets::reset();
+        frame_split::reset();
+        stalls::reset();
     }
 
 
@@ -719,23 +2820,55 @@ namespace gx2_mon {
         // TRACE;
 
         perf::finalize();
+        passes::finalize();
+        timing::finalize();
         fps::finalize();
     }
 
 
+    // Warm restart: whatever is still enabled keeps its GX2Perf data and its history;
+    // only what was disabled gets freed. Since nothing is collected while in the
+    // background, only the frames that span that pause are dropped.
     void
     reset()
     {
         // TRACE;
 
-        fps::finalize();
         if (cfg::gpu_fps)
-            fps::initialize();
+            fps::resume();
 
-        perf::finalize();
-        if (cfg::gpu_busy)
-            perf::initialize();
+        if (perf::is_wanted())
+            perf::resume();
+        else
+            perf::finalize();
+        bottleneck::reset();
 
+        if (cfg::gpu_passes)
+            passes::resume();
+        else
+            passes::finalize();
+
+        if (cfg::gpu_time)
+            timing::resume();
+        else
+            timing::finalize();
+
+        draws::reset();
+        present::reset();
+        targets::reset();
+        frame_split::resume();
+    }
+
+
+    // Called when the HUD is hidden. The swap hook stops starting frames, so the GX2Perf
+    // frames and the timestamp query that are open get closed here, and dropped; showing
+    // the HUD again (through reset()) starts fresh intervals.
+    void
+    pause()
+    {
+        perf::pause();
+        passes::pause();
+        timing::pause();
     }
 
 
@@ -743,13 +2876,17 @@ namespace gx2_mon {
     on_application_start()
     {
         initialize_lmm_heap();
+        vram::clear();
     }
 
 
     void
     on_application_ends()
     {
+        // The profiler survives pauses, so it might still be using the pool.
+        finalize();
         finalize_lmm_heap();
+        vram::clear();
     }
 
 
@@ -764,21 +2901,477 @@ namespace gx2_mon {
         if (cfg::gpu_fps)
             fps::on_frame_finish();
 
-        if (cfg::gpu_busy)
+        if (cfg::gpu_draws)
+            draws::on_frame_finish();
+
+        if (perf::is_wanted())
             perf::on_frame_finish();
 
-        overlay::render();
+        passes::on_frame_finish();
+
+        if (cfg::gpu_time)
+            timing::on_frame_finish();
 
-        real_GX2SwapScanBuffers();
+        overlay::render();
 
-        if (cfg::gpu_busy)
+        if (cfg::gpu_bottleneck || cfg::gpu_present || cfg::swap_wait) {
+            OSTime enter = OSGetSystemTime();
+            real_GX2SwapScanBuffers();
+            OSTime leave = OSGetSystemTime();
+            if (cfg::gpu_bottleneck)
+                bottleneck::on_swap(enter, leave);
+            if (cfg::swap_wait)
+                frame_split::on_swap(enter, leave);
+            if (cfg::gpu_present)
+                present::on_swap(enter);
+        } else
+            real_GX2SwapScanBuffers();
+
+        if (perf::is_wanted())
             perf::on_frame_start();
 
+        if (cfg::gpu_passes)
+            passes::on_frame_start();
+
+        if (cfg::gpu_time)
+            timing::on_frame_start();
+
     }
 
     WUPS_MUST_REPLACE(GX2SwapScanBuffers, WUPS_LOADER_LIBRARY_GX2, GX2SwapScanBuffers);
 
 
+    DECL_FUNCTION(void, GX2CopyColorBufferToScanBuffer,
+                  const GX2ColorBuffer* buffer,
+                  GX2ScanTarget target)
+    {
+        if (cfg::enabled) {
+            if (cfg::gpu_targets)
+                targets::on_copy(buffer, target);
+            gx2_overlay::draw(buffer);
+        }
+
+        real_GX2CopyColorBufferToScanBuffer(buffer, target);
+    }
+
+    WUPS_MUST_REPLACE(GX2CopyColorBufferToScanBuffer, WUPS_LOADER_LIBRARY_GX2,
+                      GX2CopyColorBufferToScanBuffer);
+
+
+    DECL_FUNCTION(void, GX2SetColorBuffer,
+                  const GX2ColorBuffer* buffer,
+                  GX2RenderTarget target)
+    {
+        if (cfg::enabled)
+            passes::on_set_color_buffer(buffer, target);
+
+        real_GX2SetColorBuffer(buffer, target);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetColorBuffer, WUPS_LOADER_LIBRARY_GX2, GX2SetColorBuffer);
+
+
+    DECL_FUNCTION(void, GX2WaitForFlip, void)
+    {
+        if (!cfg::enabled || !cfg::gpu_present)
+            return real_GX2WaitForFlip();
+
+        OSTime enter = OSGetSystemTime();
+        real_GX2WaitForFlip();
+        present::on_flip_wait(enter, OSGetSystemTime());
+        present::poll();
+    }
+
+    WUPS_MUST_REPLACE(GX2WaitForFlip, WUPS_LOADER_LIBRARY_GX2, GX2WaitForFlip);
+
+
+    DECL_FUNCTION(void, GX2WaitForVsync, void)
+    {
+        if (!cfg::enabled || !cfg::gpu_present)
+            return real_GX2WaitForVsync();
+
+        OSTime enter = OSGetSystemTime();
+        real_GX2WaitForVsync();
+        present::on_vsync_wait(enter, OSGetSystemTime());
+        present::poll();
+    }
+
+    WUPS_MUST_REPLACE(GX2WaitForVsync, WUPS_LOADER_LIBRARY_GX2, GX2WaitForVsync);
+
+
+    DECL_FUNCTION(void, GX2GetSwapStatus,
+                  std::uint32_t* swap_count,
+                  std::uint32_t* flip_count,
+                  OSTime* flip_time,
+                  OSTime* vsync_time)
+    {
+        real_GX2GetSwapStatus(swap_count, flip_count, flip_time, vsync_time);
+        if (cfg::enabled && cfg::gpu_present && swap_count && flip_count && flip_time)
+            present::on_status(*swap_count, *flip_count, *flip_time);
+    }
+
+    WUPS_MUST_REPLACE(GX2GetSwapStatus, WUPS_LOADER_LIBRARY_GX2, GX2GetSwapStatus);
+
+
+    void
+    present::get_swap_status(std::uint32_t* swap_count,
+                             std::uint32_t* flip_count,
+                             OSTime* flip_time,
+                             OSTime* vsync_time)
+    {
+        real_GX2GetSwapStatus(swap_count, flip_count, flip_time, vsync_time);
+    }
+
+
+    DECL_FUNCTION(BOOL, GX2WaitTimeStamp, OSTime timestamp)
+    {
+        if (!cfg::enabled || !cfg::gpu_stalls)
+            return real_GX2WaitTimeStamp(timestamp);
+
+        OSTime enter = OSGetSystemTime();
+        BOOL result = real_GX2WaitTimeStamp(timestamp);
+        stalls::add(stalls::wait_timestamp, __builtin_return_address(0),
+                    enter, OSGetSystemTime());
+        return result;
+    }
+
+    WUPS_MUST_REPLACE(GX2WaitTimeStamp, WUPS_LOADER_LIBRARY_GX2, GX2WaitTimeStamp);
+
+
+    DECL_FUNCTION(BOOL, GX2DrawDone, void)
+    {
+        if (!cfg::enabled || !cfg::gpu_stalls)
+            return real_GX2DrawDone();
+
+        OSTime enter = OSGetSystemTime();
+        BOOL result = real_GX2DrawDone();
+        stalls::add(stalls::draw_done_call, __builtin_return_address(0),
+                    enter, OSGetSystemTime());
+        return result;
+    }
+
+    WUPS_MUST_REPLACE(GX2DrawDone, WUPS_LOADER_LIBRARY_GX2, GX2DrawDone);
+
+
+    void
+    stalls::draw_done()
+    {
+        real_GX2DrawDone();
+    }
+
+
+    DECL_FUNCTION(void*, GX2RLockBufferEx,
+                  GX2RBuffer* buffer,
+                  GX2RResourceFlags flags)
+    {
+        if (!cfg::enabled || !cfg::gpu_stalls)
+            return real_GX2RLockBufferEx(buffer, flags);
+
+        OSTime enter = OSGetSystemTime();
+        void* result = real_GX2RLockBufferEx(buffer, flags);
+        stalls::add(stalls::lock_buffer, __builtin_return_address(0),
+                    enter, OSGetSystemTime());
+        return result;
+    }
+
+    WUPS_MUST_REPLACE(GX2RLockBufferEx, WUPS_LOADER_LIBRARY_GX2, GX2RLockBufferEx);
+
+
+    DECL_FUNCTION(void*, GX2RLockSurfaceEx,
+                  GX2Surface* surface,
+                  std::int32_t level,
+                  GX2RResourceFlags flags)
+    {
+        if (!cfg::enabled || !cfg::gpu_stalls)
+            return real_GX2RLockSurfaceEx(surface, level, flags);
+
+        OSTime enter = OSGetSystemTime();
+        void* result = real_GX2RLockSurfaceEx(surface, level, flags);
+        stalls::add(stalls::lock_surface, __builtin_return_address(0),
+                    enter, OSGetSystemTime());
+        return result;
+    }
+
+    WUPS_MUST_REPLACE(GX2RLockSurfaceEx, WUPS_LOADER_LIBRARY_GX2, GX2RLockSurfaceEx);
+
+
+    // GX2R resources
+
+    DECL_FUNCTION(BOOL, GX2RCreateSurface,
+                  GX2Surface* surface,
+                  GX2RResourceFlags flags)
+    {
+        BOOL result = real_GX2RCreateSurface(surface, flags);
+        // GX2RCreateSurface() already called GX2CalcSurfaceSizeAndAlignment().
+        if (result)
+            vram::add(surface, surface->image, surface->imageSize + surface->mipmapSize);
+        return result;
+    }
+
+    WUPS_MUST_REPLACE(GX2RCreateSurface, WUPS_LOADER_LIBRARY_GX2, GX2RCreateSurface);
+
+
+    DECL_FUNCTION(void, GX2RDestroySurfaceEx,
+                  GX2Surface* surface,
+                  GX2RResourceFlags flags)
+    {
+        vram::remove(surface);
+        real_GX2RDestroySurfaceEx(surface, flags);
+    }
+
+    WUPS_MUST_REPLACE(GX2RDestroySurfaceEx, WUPS_LOADER_LIBRARY_GX2, GX2RDestroySurfaceEx);
+
+
+    DECL_FUNCTION(BOOL, GX2RCreateBuffer, GX2RBuffer* buffer)
+    {
+        BOOL result = real_GX2RCreateBuffer(buffer);
+        if (result)
+            vram::add(buffer, buffer->buffer, GX2RGetBufferAllocationSize(buffer));
+        return result;
+    }
+
+    WUPS_MUST_REPLACE(GX2RCreateBuffer, WUPS_LOADER_LIBRARY_GX2, GX2RCreateBuffer);
+
+
+    DECL_FUNCTION(void, GX2RDestroyBufferEx,
+                  GX2RBuffer* buffer,
+                  GX2RResourceFlags flags)
+    {
+        vram::remove(buffer);
+        real_GX2RDestroyBufferEx(buffer, flags);
+    }
+
+    WUPS_MUST_REPLACE(GX2RDestroyBufferEx, WUPS_LOADER_LIBRARY_GX2, GX2RDestroyBufferEx);
+
+
+    // Draw calls
+
+    DECL_FUNCTION(void, GX2DrawEx,
+                  GX2PrimitiveMode mode,
+                  std::uint32_t count,
+                  std::uint32_t offset,
+                  std::uint32_t num_instances)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_draw(count * num_instances);
+        real_GX2DrawEx(mode, count, offset, num_instances);
+    }
+
+    WUPS_MUST_REPLACE(GX2DrawEx, WUPS_LOADER_LIBRARY_GX2, GX2DrawEx);
+
+
+    DECL_FUNCTION(void, GX2DrawEx2,
+                  GX2PrimitiveMode mode,
+                  std::uint32_t count,
+                  std::uint32_t offset,
+                  std::uint32_t num_instances,
+                  std::uint32_t base_instance)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_draw(count * num_instances);
+        real_GX2DrawEx2(mode, count, offset, num_instances, base_instance);
+    }
+
+    WUPS_MUST_REPLACE(GX2DrawEx2, WUPS_LOADER_LIBRARY_GX2, GX2DrawEx2);
+
+
+    DECL_FUNCTION(void, GX2DrawIndexedEx,
+                  GX2PrimitiveMode mode,
+                  std::uint32_t count,
+                  GX2IndexType index_type,
+                  const void* indices,
+                  std::uint32_t offset,
+                  std::uint32_t num_instances)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_draw(count * num_instances);
+        real_GX2DrawIndexedEx(mode, count, index_type, indices, offset, num_instances);
+    }
+
+    WUPS_MUST_REPLACE(GX2DrawIndexedEx, WUPS_LOADER_LIBRARY_GX2, GX2DrawIndexedEx);
+
+
+    DECL_FUNCTION(void, GX2DrawIndexedEx2,
+                  GX2PrimitiveMode mode,
+                  std::uint32_t count,
+                  GX2IndexType index_type,
+                  const void* indices,
+                  std::uint32_t offset,
+                  std::uint32_t num_instances,
+                  std::uint32_t base_instance)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_draw(count * num_instances);
+        real_GX2DrawIndexedEx2(mode, count, index_type, indices, offset, num_instances,
+                               base_instance);
+    }
+
+    WUPS_MUST_REPLACE(GX2DrawIndexedEx2, WUPS_LOADER_LIBRARY_GX2, GX2DrawIndexedEx2);
+
+
+    DECL_FUNCTION(void, GX2DrawIndexedImmediateEx,
+                  GX2PrimitiveMode mode,
+                  std::uint32_t count,
+                  GX2IndexType index_type,
+                  const void* indices,
+                  std::uint32_t offset,
+                  std::uint32_t num_instances)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_draw(count * num_instances);
+        real_GX2DrawIndexedImmediateEx(mode, count, index_type, indices, offset,
+                                       num_instances);
+    }
+
+    WUPS_MUST_REPLACE(GX2DrawIndexedImmediateEx, WUPS_LOADER_LIBRARY_GX2,
+                      GX2DrawIndexedImmediateEx);
+
+
+    // The vertex count is only known by the GPU.
+    DECL_FUNCTION(void, GX2DrawStreamOut,
+                  GX2PrimitiveMode mode,
+                  GX2OutputStream* buffer)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_draw(0);
+        real_GX2DrawStreamOut(mode, buffer);
+    }
+
+    WUPS_MUST_REPLACE(GX2DrawStreamOut, WUPS_LOADER_LIBRARY_GX2, GX2DrawStreamOut);
+
+
+    // Shaders
+
+    DECL_FUNCTION(void, GX2SetFetchShader, const GX2FetchShader* shader)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_state_change();
+        real_GX2SetFetchShader(shader);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetFetchShader, WUPS_LOADER_LIBRARY_GX2, GX2SetFetchShader);
+
+
+    DECL_FUNCTION(void, GX2SetVertexShader, const GX2VertexShader* shader)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_state_change();
+        real_GX2SetVertexShader(shader);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetVertexShader, WUPS_LOADER_LIBRARY_GX2, GX2SetVertexShader);
+
+
+    DECL_FUNCTION(void, GX2SetPixelShader, const GX2PixelShader* shader)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_state_change();
+        real_GX2SetPixelShader(shader);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetPixelShader, WUPS_LOADER_LIBRARY_GX2, GX2SetPixelShader);
+
+
+    DECL_FUNCTION(void, GX2SetGeometryShader, const GX2GeometryShader* shader)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_state_change();
+        real_GX2SetGeometryShader(shader);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetGeometryShader, WUPS_LOADER_LIBRARY_GX2, GX2SetGeometryShader);
+
+
+    // Textures
+
+    DECL_FUNCTION(void, GX2SetPixelTexture,
+                  const GX2Texture* texture,
+                  std::uint32_t unit)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_state_change();
+        real_GX2SetPixelTexture(texture, unit);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetPixelTexture, WUPS_LOADER_LIBRARY_GX2, GX2SetPixelTexture);
+
+
+    DECL_FUNCTION(void, GX2SetVertexTexture,
+                  const GX2Texture* texture,
+                  std::uint32_t unit)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_state_change();
+        real_GX2SetVertexTexture(texture, unit);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetVertexTexture, WUPS_LOADER_LIBRARY_GX2, GX2SetVertexTexture);
+
+
+    // Render state
+
+    DECL_FUNCTION(void, GX2SetBlendControl,
+                  GX2RenderTarget target,
+                  GX2BlendMode color_src,
+                  GX2BlendMode color_dst,
+                  GX2BlendCombineMode color_combine,
+                  BOOL use_alpha_blend,
+                  GX2BlendMode alpha_src,
+                  GX2BlendMode alpha_dst,
+                  GX2BlendCombineMode alpha_combine)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_state_change();
+        real_GX2SetBlendControl(target,
+                                color_src, color_dst, color_combine,
+                                use_alpha_blend,
+                                alpha_src, alpha_dst, alpha_combine);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetBlendControl, WUPS_LOADER_LIBRARY_GX2, GX2SetBlendControl);
+
+
+    DECL_FUNCTION(void, GX2SetColorControl,
+                  GX2LogicOp rop3,
+                  std::uint8_t blend_mask,
+                  BOOL multi_write,
+                  BOOL color_write)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_state_change();
+        real_GX2SetColorControl(rop3, blend_mask, multi_write, color_write);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetColorControl, WUPS_LOADER_LIBRARY_GX2, GX2SetColorControl);
+
+
+    DECL_FUNCTION(void, GX2SetDepthStencilControl,
+                  BOOL depth_test,
+                  BOOL depth_write,
+                  GX2CompareFunction depth_compare,
+                  BOOL stencil_test,
+                  BOOL back_stencil,
+                  GX2CompareFunction front_compare,
+                  GX2StencilFunction front_zpass,
+                  GX2StencilFunction front_zfail,
+                  GX2StencilFunction front_fail,
+                  GX2CompareFunction back_compare,
+                  GX2StencilFunction back_zpass,
+                  GX2StencilFunction back_zfail,
+                  GX2StencilFunction back_fail)
+    {
+        if (cfg::enabled && cfg::gpu_draws)
+            draws::add_state_change();
+        real_GX2SetDepthStencilControl(depth_test, depth_write, depth_compare,
+                                       stencil_test, back_stencil,
+                                       front_compare, front_zpass, front_zfail, front_fail,
+                                       back_compare, back_zpass, back_zfail, back_fail);
+    }
+
+    WUPS_MUST_REPLACE(GX2SetDepthStencilControl, WUPS_LOADER_LIBRARY_GX2,
+                      GX2SetDepthStencilControl);
+
+
     DECL_FUNCTION(void, GX2Init, std::uint32_t* attr)
     {
         // logger::printf("GX2Init() was called on core %u\n", OSGetCoreId());
@@ -14,6 +14,47 @@ namespace gx2_mon {
 
     namespace perf {
         const char* get_report(float dt);
+        const char* get_bandwidth_report(float dt);
+        const char* get_stages_report(float dt);
+    }
+
+    namespace passes {
+        const char* get_report(float dt);
+    }
+
+    namespace timing {
+        const char* get_report(float dt);
+    }
+
+    namespace bottleneck {
+        const char* get_report(float dt);
+    }
+
+    namespace frame_split {
+        const char* get_report(float dt);
+    }
+
+    namespace stalls {
+        const char* get_report(float dt);
+
+        // GX2DrawDone() for the plugin's own use, that isn't counted as a stall.
+        void draw_done();
+    }
+
+    namespace vram {
+        const char* get_report(float dt);
+    }
+
+    namespace present {
+        const char* get_report(float dt);
+    }
+
+    namespace draws {
+        const char* get_report(float dt);
+    }
+
+    namespace targets {
+        const char* get_report(float dt);
     }
 
     namespace fps {
@@ -23,6 +64,7 @@ namespace gx2_mon {
     void initialize();
     void finalize();
     void reset();
+    void pause();
 
     void on_application_start();
     void on_application_ends();
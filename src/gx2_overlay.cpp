@@ -0,0 +1,255 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * GX2 Overlay
+ *
+ * This is the native renderer backend. Whenever the HUD text changes, the CPU rasterizer
+ * (see render.cpp) draws it into a small linear surface. Then, on every frame, that
+ * surface is copied into the game's color buffer, right before the color buffer is copied
+ * into the scan buffer: a single `GX2CopySurfaceEx()` per target, no shaders and no
+ * mutexes.
+ *
+ * Because it's a plain copy, there's no blending with the game's image, so the background
+ * is always opaque.
+ *
+ * Like `GX2CopyColorBufferToScanBuffer()` itself, the copy disturbs the GPU context state;
+ * games already have to restore it after the scan buffer copy, so it's safe to do it
+ * there.
+ *
+ * Drawing textured quads from a vertex buffer, with one draw call, would allow blending,
+ * but it needs compiled GX2 shaders, plus saving and restoring all the context state the
+ * draw touches. The draw list is already batched the same way, so that backend can be
+ * added on top of it later.
+ *
+ * The copy only works into single-sample RGBA8 color buffers. When a game uses anything
+ * else, the HUD falls back to the notification.
+ */
+
+#include <algorithm>            // min()
+#include <atomic>
+
+#include <gx2/mem.h>
+#include <memory/mappedmemory.h>
+
+#include "gx2_overlay.hpp"
+
+#include "cfg.hpp"
+#include "gx2_mon.hpp"
+#include "logger.hpp"
+#include "render.hpp"
+
+
+namespace gx2_overlay {
+
+    namespace {
+
+        // The DRC is the narrowest target, at 854 pixels.
+        const unsigned max_width = 848;
+        const unsigned max_lines = 6;
+        const unsigned max_height = max_lines * render::glyph_atlas::cell_height + 8;
+
+        // Distance from the top left corner of the screen.
+        const unsigned margin = 8;
+
+
+        render::glyph_atlas atlas;
+        render::draw_list list;
+
+        // Double-buffered, so we never draw into a surface the GPU might still be reading.
+        GX2Surface staging[2];
+        unsigned current = 0;
+        bool created = false;
+        // A copy from the staging surfaces was queued since they were created.
+        bool copied = false;
+
+        // Set the first time a color buffer can't take the copy.
+        std::atomic_bool unsupported = false;
+
+        // Size of the HUD box in staging[current].
+        unsigned box_width = 0;
+        unsigned box_height = 0;
+
+
+        render::rgba
+        convert(wups::utils::color c)
+        {
+            return (render::rgba{c.r} << 24)
+                |  (render::rgba{c.g} << 16)
+                |  (render::rgba{c.b} << 8)
+                |   render::rgba{c.a};
+        }
+
+
+        void
+        free_surfaces()
+        {
+            for (auto& s : staging) {
+                if (s.image)
+                    MEMFreeToMappedMemory(s.image);
+                s.image = nullptr;
+            }
+        }
+
+    } // namespace
+
+
+    void
+    initialize()
+    {
+        atlas.bake();
+    }
+
+
+    void
+    on_application_start()
+    {
+        // The next game might use color buffers we can copy into.
+        unsupported = false;
+    }
+
+
+    void
+    create()
+    {
+        if (created)
+            return;
+
+        for (auto& s : staging) {
+            s = {};
+            s.dim = GX2_SURFACE_DIM_TEXTURE_2D;
+            s.width = max_width;
+            s.height = max_height;
+            s.depth = 1;
+            s.mipLevels = 1;
+            s.format = GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8;
+            s.aa = GX2_AA_MODE1X;
+            s.use = GX2_SURFACE_USE_TEXTURE;
+            s.tileMode = GX2_TILE_MODE_LINEAR_ALIGNED;
+            GX2CalcSurfaceSizeAndAlignment(&s);
+
+            s.image = MEMAllocFromMappedMemoryForGX2Ex(s.imageSize, s.alignment);
+            if (!s.image) {
+                logger::printf("Failed to allocate %u bytes for the overlay surface.\n",
+                               s.imageSize);
+                free_surfaces();
+                return;
+            }
+        }
+
+        current = 0;
+        box_width = 0;
+        box_height = 0;
+        copied = false;
+        created = true;
+    }
+
+
+    void
+    destroy()
+    {
+        if (!created)
+            return;
+
+        created = false;
+        box_width = 0;
+        box_height = 0;
+        // Don't free anything the GPU might still be copying from.
+        if (copied)
+            gx2_mon::stalls::draw_done();
+        copied = false;
+        free_surfaces();
+    }
+
+
+    bool
+    is_created()
+    {
+        return created;
+    }
+
+
+    bool
+    is_unsupported()
+    {
+        return unsupported;
+    }
+
+
+    void
+    update(std::string_view text)
+    {
+        if (!created)
+            return;
+
+        const unsigned next = current ^ 1;
+        GX2Surface& surface = staging[next];
+
+        // Without blending, a translucent background makes no sense.
+        const render::rgba bg = convert(cfg::color_bg) | 0xff;
+        render::layout_text(list, atlas, text, max_width, convert(cfg::color_fg), bg);
+
+        render::framebuffer fb{
+            .pixels = static_cast<render::rgba*>(surface.image),
+            .width = std::min(list.width, max_width),
+            .height = std::min(list.height, max_height),
+            .pitch = surface.pitch
+        };
+        render::rasterize(list, atlas, fb);
+
+        GX2Invalidate(GX2_INVALIDATE_MODE_CPU_TEXTURE, surface.image, surface.imageSize);
+
+        box_width = fb.width;
+        box_height = fb.height;
+        current = next;
+    }
+
+
+    void
+    draw(const GX2ColorBuffer* buffer)
+    {
+        if (!created || !box_width || !buffer)
+            return;
+
+        const GX2Surface& dst = buffer->surface;
+        if (dst.aa != GX2_AA_MODE1X
+            || (dst.format != GX2_SURFACE_FORMAT_UNORM_R8_G8_B8_A8
+                && dst.format != GX2_SURFACE_FORMAT_SRGB_R8_G8_B8_A8)) {
+            // overlay::render() will switch to the notification.
+            if (!unsupported.exchange(true))
+                logger::printf("Native renderer can't draw into color buffer"
+                               " (format 0x%x, AA mode %u), using the notification.\n",
+                               static_cast<unsigned>(dst.format),
+                               static_cast<unsigned>(dst.aa));
+            return;
+        }
+        if (dst.width <= margin || dst.height <= margin)
+            return;
+
+        GX2Surface& src = staging[current];
+        // Same bits either way, the copy only needs the formats to agree.
+        src.format = dst.format;
+
+        GX2Rect rect{
+            .left = 0,
+            .top = 0,
+            .right = static_cast<std::int32_t>(std::min(box_width, dst.width - margin)),
+            .bottom = static_cast<std::int32_t>(std::min(box_height, dst.height - margin))
+        };
+        GX2Point point{
+            .x = margin,
+            .y = margin
+        };
+        GX2CopySurfaceEx(&src, 0, 0,
+                         const_cast<GX2Surface*>(&dst),
+                         buffer->viewMip, buffer->viewFirstSlice,
+                         1, &rect, &point);
+        copied = true;
+    }
+
+} // namespace gx2_overlay
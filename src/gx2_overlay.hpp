@@ -0,0 +1,37 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef GX2_OVERLAY_HPP
+#define GX2_OVERLAY_HPP
+
+#include <string_view>
+
+#include <gx2/surface.h>
+
+
+namespace gx2_overlay {
+
+    void initialize();
+
+    void on_application_start();
+
+    void create();
+    void destroy();
+    bool is_created();
+
+    void update(std::string_view text);
+
+    void draw(const GX2ColorBuffer* buffer);
+
+    // True when the game's color buffers can't take the HUD, so the notification has to be
+    // used instead.
+    bool is_unsupported();
+
+} // namespace gx2_overlay
+
+#endif
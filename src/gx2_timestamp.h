@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef GX2_TIMESTAMP_H
+#define GX2_TIMESTAMP_H
+
+#include <stdint.h>
+#include <wut.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// The GPU writes its timestamp counter into *result, when the command reaches the top of
+// the pipeline (before previous commands finish), or the bottom of the pipeline (after
+// all previous commands finish). The result must be in GPU-visible memory.
+void GX2SampleTopGPUCycle(uint64_t* result);
+void GX2SampleBottomGPUCycle(uint64_t* result);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
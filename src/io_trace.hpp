@@ -0,0 +1,322 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * I/O trace format
+ *
+ * A trace file starts with a fixed 32-byte header, followed by variable-length records,
+ * one per completed FSA request. Integers in the header are big-endian; record fields
+ * are LEB128 varints, and the status is zigzag-encoded first.
+ *
+ * Header:
+ *     magic       8 bytes, "PHUDIOTR"
+ *     version     u32
+ *     reserved    u32
+ *     title_id    u64
+ *     start_time  u64, microseconds since 2000-01-01
+ *
+ * Record:
+ *     kind        varint: the FSA command shifted left by 1, with bit 0 set if an
+ *                 offset follows; 0 ends the trace
+ *     time        varint: microseconds since the previous record (since start_time
+ *                 for the first one), when the request completed
+ *     handle      varint: file or raw device handle (0 if it doesn't have one)
+ *     offset      varint: only if bit 0 of kind is set
+ *     size        varint: element size
+ *     count       varint: element count
+ *     latency     varint: microseconds from submit to completion
+ *     status      zigzag varint: the FSA status; for reads and writes, elements done
+ *     path        only for opens: varint length, then the bytes
+ *
+ * The end record only has the kind (0), time, and the number of records that were
+ * dropped because the ring was full.
+ *
+ * This header is shared by the plugin and the host-side analyzer (tools/), so it doesn't
+ * depend on WUT.
+ */
+
+#ifndef IO_TRACE_HPP
+#define IO_TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+
+namespace io_trace {
+
+    constexpr char magic[8] = {'P', 'H', 'U', 'D', 'I', 'O', 'T', 'R'};
+    constexpr std::uint32_t version = 1;
+    constexpr std::size_t header_size = 32;
+
+    // Same values as FSACommand.
+    enum command : std::uint32_t {
+        cmd_end          = 0x00,
+        cmd_open_dir     = 0x0a,
+        cmd_read_dir     = 0x0b,
+        cmd_close_dir    = 0x0d,
+        cmd_open_file    = 0x0e,
+        cmd_read_file    = 0x0f,
+        cmd_write_file   = 0x10,
+        cmd_get_pos_file = 0x11,
+        cmd_set_pos_file = 0x12,
+        cmd_is_eof       = 0x13,
+        cmd_stat_file    = 0x14,
+        cmd_close_file   = 0x15,
+        cmd_get_info     = 0x18,
+        cmd_raw_open     = 0x1a,
+        cmd_raw_read     = 0x1b,
+        cmd_raw_write    = 0x1c,
+        cmd_raw_close    = 0x1d,
+    };
+
+    struct header {
+        std::uint64_t title_id;
+        std::uint64_t start_time;
+    };
+
+    struct record {
+        std::uint32_t    command;
+        std::uint64_t    time;     // absolute, in microseconds
+        std::uint32_t    handle;
+        bool             has_offset;
+        std::uint64_t    offset;
+        std::uint32_t    size;
+        std::uint32_t    count;
+        std::uint32_t    latency;
+        std::int32_t     status;
+        std::string_view path;
+    };
+
+    // Largest encoded record, not counting the path.
+    constexpr std::size_t max_record_size = 2 * 5 + 10 + 5 + 10 + 4 * 5 + 5;
+
+
+    constexpr
+    bool
+    has_path(std::uint32_t command)
+        noexcept
+    {
+        return command == cmd_open_file || command == cmd_raw_open;
+    }
+
+
+    inline
+    std::uint8_t*
+    put_varint(std::uint8_t* out,
+               std::uint64_t value)
+        noexcept
+    {
+        while (value >= 0x80) {
+            *out++ = static_cast<std::uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = static_cast<std::uint8_t>(value);
+        return out;
+    }
+
+
+    // Returns false if the input ends in the middle of the varint.
+    inline
+    bool
+    get_varint(const std::uint8_t*& in,
+               const std::uint8_t* end,
+               std::uint64_t& value)
+        noexcept
+    {
+        value = 0;
+        for (unsigned shift = 0; in != end && shift < 64; shift += 7) {
+            const std::uint8_t b = *in++;
+            value |= std::uint64_t{b & 0x7fu} << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+
+    constexpr
+    std::uint32_t
+    zigzag(std::int32_t value)
+        noexcept
+    {
+        return (static_cast<std::uint32_t>(value) << 1)
+            ^ static_cast<std::uint32_t>(value >> 31);
+    }
+
+
+    constexpr
+    std::int32_t
+    unzigzag(std::uint32_t value)
+        noexcept
+    {
+        return static_cast<std::int32_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+
+    inline
+    void
+    put_be(std::uint8_t* out,
+           std::uint64_t value,
+           unsigned bytes)
+        noexcept
+    {
+        for (unsigned i = 0; i < bytes; ++i)
+            out[i] = static_cast<std::uint8_t>(value >> (8 * (bytes - 1 - i)));
+    }
+
+
+    inline
+    std::uint64_t
+    get_be(const std::uint8_t* in,
+           unsigned bytes)
+        noexcept
+    {
+        std::uint64_t value = 0;
+        for (unsigned i = 0; i < bytes; ++i)
+            value = (value << 8) | in[i];
+        return value;
+    }
+
+
+    inline
+    void
+    encode_header(std::uint8_t* out,
+                  const header& h)
+        noexcept
+    {
+        std::memcpy(out, magic, sizeof magic);
+        put_be(out + 8, version, 4);
+        put_be(out + 12, 0, 4);
+        put_be(out + 16, h.title_id, 8);
+        put_be(out + 24, h.start_time, 8);
+    }
+
+
+    // Returns false if it's not a trace, or a version this doesn't know.
+    inline
+    bool
+    decode_header(const std::uint8_t* in,
+                  std::size_t size,
+                  header& h)
+        noexcept
+    {
+        if (size < header_size || std::memcmp(in, magic, sizeof magic))
+            return false;
+        if (get_be(in + 8, 4) != version)
+            return false;
+        h.title_id = get_be(in + 16, 8);
+        h.start_time = get_be(in + 24, 8);
+        return true;
+    }
+
+
+    // The output needs max_record_size bytes, plus the path's length for opens. The
+    // previous time is updated.
+    inline
+    std::uint8_t*
+    encode_record(std::uint8_t* out,
+                  const record& r,
+                  std::uint64_t& prev_time)
+        noexcept
+    {
+        out = put_varint(out, std::uint64_t{r.command} << 1 | r.has_offset);
+        out = put_varint(out, r.time - prev_time);
+        prev_time = r.time;
+        out = put_varint(out, r.handle);
+        if (r.has_offset)
+            out = put_varint(out, r.offset);
+        out = put_varint(out, r.size);
+        out = put_varint(out, r.count);
+        out = put_varint(out, r.latency);
+        out = put_varint(out, zigzag(r.status));
+        if (has_path(r.command)) {
+            out = put_varint(out, r.path.size());
+            std::memcpy(out, r.path.data(), r.path.size());
+            out += r.path.size();
+        }
+        return out;
+    }
+
+
+    inline
+    std::uint8_t*
+    encode_end(std::uint8_t* out,
+               std::uint64_t time,
+               std::uint64_t& prev_time,
+               std::uint32_t dropped)
+        noexcept
+    {
+        out = put_varint(out, cmd_end);
+        out = put_varint(out, time - prev_time);
+        prev_time = time;
+        return put_varint(out, dropped);
+    }
+
+
+    // Decodes one record; for the end record, the number of dropped records goes into
+    // count. Returns false if the input is truncated.
+    inline
+    bool
+    decode_record(const std::uint8_t*& in,
+                  const std::uint8_t* end,
+                  record& r,
+                  std::uint64_t& prev_time)
+        noexcept
+    {
+        std::uint64_t v;
+        if (!get_varint(in, end, v))
+            return false;
+        r = {};
+        r.command = static_cast<std::uint32_t>(v >> 1);
+        r.has_offset = v & 1;
+
+        if (!get_varint(in, end, v))
+            return false;
+        r.time = prev_time + v;
+        prev_time = r.time;
+
+        if (r.command == cmd_end) {
+            if (!get_varint(in, end, v))
+                return false;
+            r.count = static_cast<std::uint32_t>(v);
+            return true;
+        }
+
+        if (!get_varint(in, end, v))
+            return false;
+        r.handle = static_cast<std::uint32_t>(v);
+        if (r.has_offset) {
+            if (!get_varint(in, end, r.offset))
+                return false;
+        }
+        if (!get_varint(in, end, v))
+            return false;
+        r.size = static_cast<std::uint32_t>(v);
+        if (!get_varint(in, end, v))
+            return false;
+        r.count = static_cast<std::uint32_t>(v);
+        if (!get_varint(in, end, v))
+            return false;
+        r.latency = static_cast<std::uint32_t>(v);
+        if (!get_varint(in, end, v))
+            return false;
+        r.status = unzigzag(static_cast<std::uint32_t>(v));
+        if (has_path(r.command)) {
+            if (!get_varint(in, end, v) || v > std::uint64_t(end - in))
+                return false;
+            r.path = {reinterpret_cast<const char*>(in), static_cast<std::size_t>(v)};
+            in += v;
+        }
+        return true;
+    }
+
+} // namespace io_trace
+
+#endif
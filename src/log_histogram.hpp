@@ -0,0 +1,164 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Log-scaled histogram
+ *
+ * A streaming quantile estimator for positive integer samples (e.g. durations in
+ * microseconds). Adding or removing a sample is O(1), and no samples are stored. Values
+ * below 16 get their own buckets; above that, every power of two is split into 16
+ * buckets, so any quantile is off by at most 1/32 (about 3%) of the true value.
+ *
+ * atomic_log_histogram has the same buckets, but any thread can add to it without a lock;
+ * the reader moves the counts into a log_histogram to compute quantiles.
+ *
+ * tools/test-log-histogram.cpp checks the error bound against exact sorting, and
+ * measures the cost of both; nothing here depends on WUT.
+ */
+
+#ifndef LOG_HISTOGRAM_HPP
+#define LOG_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+
+namespace utils {
+
+    struct log_histogram {
+
+        static constexpr unsigned sub_bits = 4;
+        static constexpr unsigned sub_buckets = 1u << sub_bits;
+        static constexpr unsigned num_buckets = (32 - sub_bits + 1) * sub_buckets;
+
+        std::array<std::uint32_t, num_buckets> buckets{};
+        std::uint32_t count = 0;
+
+
+        static
+        unsigned
+        bucket_of(std::uint32_t value)
+            noexcept
+        {
+            if (value < sub_buckets)
+                return value;
+            unsigned exp = std::bit_width(value) - 1;
+            unsigned mantissa = (value >> (exp - sub_bits)) & (sub_buckets - 1);
+            return (exp - sub_bits + 1) * sub_buckets + mantissa;
+        }
+
+
+        // Middle of the range of values that land in a bucket.
+        static
+        float
+        bucket_value(unsigned bucket)
+            noexcept
+        {
+            if (bucket < sub_buckets)
+                return bucket;
+            unsigned exp = bucket / sub_buckets + sub_bits - 1;
+            unsigned mantissa = bucket % sub_buckets;
+            float low = std::ldexp(float(sub_buckets + mantissa), exp - sub_bits);
+            float width = std::ldexp(1.0f, exp - sub_bits);
+            return low + width / 2;
+        }
+
+
+        void
+        clear()
+            noexcept
+        {
+            buckets.fill(0);
+            count = 0;
+        }
+
+
+        void
+        add(std::uint32_t value)
+            noexcept
+        {
+            ++buckets[bucket_of(value)];
+            ++count;
+        }
+
+
+        // Only remove values that were added before.
+        void
+        remove(std::uint32_t value)
+            noexcept
+        {
+            --buckets[bucket_of(value)];
+            --count;
+        }
+
+
+        // Estimated value below which a fraction q (between 0 and 1) of the samples fall.
+        float
+        quantile(float q)
+            const noexcept
+        {
+            if (!count)
+                return 0;
+            std::uint32_t rank = std::ceil(q * count);
+            if (rank < 1)
+                rank = 1;
+            std::uint32_t sum = 0;
+            for (unsigned b = 0; b < num_buckets; ++b) {
+                sum += buckets[b];
+                if (sum >= rank)
+                    return bucket_value(b);
+            }
+            return bucket_value(num_buckets - 1);
+        }
+
+    };
+
+
+    struct atomic_log_histogram {
+
+        std::array<std::atomic_uint32_t, log_histogram::num_buckets> buckets{};
+
+
+        void
+        add(std::uint32_t value)
+            noexcept
+        {
+            const unsigned b = log_histogram::bucket_of(value);
+            buckets[b].fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        // Moves all the counts into dst (which is cleared first), and empties this one.
+        void
+        take(log_histogram& dst)
+            noexcept
+        {
+            dst.count = 0;
+            for (unsigned b = 0; b < buckets.size(); ++b) {
+                dst.buckets[b] = buckets[b].exchange(0, std::memory_order_relaxed);
+                dst.count += dst.buckets[b];
+            }
+        }
+
+
+        void
+        clear()
+            noexcept
+        {
+            for (auto& b : buckets)
+                b.store(0, std::memory_order_relaxed);
+        }
+
+    };
+
+} // namespace utils
+
+#endif
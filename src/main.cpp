@@ -13,6 +13,7 @@
 #include <wups.h>
 
 #include "cfg.hpp"
+#include "fs_mon.hpp"
 #include "gx2_mon.hpp"
 #include "logger.hpp"
 #include "overlay.hpp"
@@ -59,6 +60,8 @@ ON_APPLICATION_START()
 {
     app_log_guard.emplace();
     gx2_mon::on_application_start();
+    fs_mon::on_application_start();
+    overlay::on_application_start();
 }
 
 
@@ -70,6 +73,8 @@ ON_APPLICATION_REQUESTS_EXIT()
 
 ON_APPLICATION_ENDS()
 {
+    overlay::on_application_ends();
+    fs_mon::on_application_ends();
     gx2_mon::on_application_ends();
     app_log_guard.reset();
 }
@@ -13,9 +13,9 @@
  */
 
 #include <algorithm>
-#include <atomic>
 #include <cstdio>
 
+#include <coreinit/core.h>      // OSGetCoreId()
 #include <nsysnet/netconfig.h>
 #include <sys/socket.h>         // struct sockaddr
 #include <wups.h>
@@ -23,6 +23,7 @@
 #include "net_mon.hpp"
 
 #include "cfg.hpp"
+#include "sharded_counter.hpp"
 
 
 using namespace std::literals;
@@ -42,8 +43,8 @@ namespace {
 
 namespace net_mon {
 
-    std::atomic_uint bytes_received = 0;
-    std::atomic_uint bytes_sent = 0;
+    utils::sharded_counter<> bytes_received;
+    utils::sharded_counter<> bytes_sent;
 
 
     void
@@ -61,8 +62,8 @@ namespace net_mon {
     void
     reset()
     {
-        bytes_received = 0;
-        bytes_sent = 0;
+        bytes_received.clear();
+        bytes_sent.clear();
     }
 
 
@@ -94,8 +95,8 @@ namespace net_mon {
 
         if (cfg::net_bw) {
 
-            const unsigned down = std::atomic_exchange(&bytes_received, 0u);
-            const unsigned up = std::atomic_exchange(&bytes_sent, 0u);
+            const float down = bytes_received.take();
+            const float up = bytes_sent.take();
 
             const float down_rate = down / 1024.0f / dt;
             const float up_rate = up / 1024.0f / dt;
@@ -134,7 +135,7 @@ DECL_FUNCTION(int, recv,
 {
     int result = real_recv(fd, buf, len, flags);
     if (result != -1 && cfg::net_bw)
-        net_mon::bytes_received += result;
+        net_mon::bytes_received.add(OSGetCoreId(), result);
     return result;
 }
 
@@ -149,7 +150,7 @@ DECL_FUNCTION(int, recvfrom,
 {
     int result = real_recvfrom(fd, buf, len, flags, src, src_len);
     if (result != -1 && cfg::net_bw)
-        net_mon::bytes_received += result;
+        net_mon::bytes_received.add(OSGetCoreId(), result);
     return result;
 }
 
@@ -166,7 +167,7 @@ DECL_FUNCTION(int, recvfrom_ex,
 {
     int result = real_recvfrom_ex(fd, buf, len, flags, src, src_len, msg, msg_len);
     if (result != -1 && cfg::net_bw)
-        net_mon::bytes_received += result;
+        net_mon::bytes_received.add(OSGetCoreId(), result);
     return result;
 }
 
@@ -181,7 +182,7 @@ DECL_FUNCTION(int, recvfrom_multi,
 {
     int result = real_recvfrom_multi(fd, flags, buffs, data_len, data_count, timeout);
     if (result != -1 && cfg::net_bw)
-        net_mon::bytes_received += result;
+        net_mon::bytes_received.add(OSGetCoreId(), result);
     return result;
 }
 
@@ -194,7 +195,7 @@ DECL_FUNCTION(int, send,
 {
     int result = real_send(fd, buf, len, flags);
     if (result != -1 && cfg::net_bw)
-        net_mon::bytes_sent += result;
+        net_mon::bytes_sent.add(OSGetCoreId(), result);
     return result;
 }
 
@@ -209,7 +210,7 @@ DECL_FUNCTION(int, sendto,
 {
     int result = real_sendto(fd, buf, len, flags, dst, dst_len);
     if (result != -1 && cfg::net_bw)
-        net_mon::bytes_sent += result;
+        net_mon::bytes_sent.add(OSGetCoreId(), result);
     return result;
 }
 
@@ -224,7 +225,7 @@ DECL_FUNCTION(int, sendto_multi,
 {
     int result = real_sendto_multi(fd, buf, len, flags, dstv, dstv_len);
     if (result != -1 && cfg::net_bw)
-        net_mon::bytes_sent += result;
+        net_mon::bytes_sent.add(OSGetCoreId(), result);
     return result;
 }
 
@@ -237,7 +238,7 @@ DECL_FUNCTION(int, sendto_multi_ex,
 {
     int result = real_sendto_multi_ex(fd, flags, buffs, count);
     if (result != -1 && cfg::net_bw)
-        net_mon::bytes_sent += result;
+        net_mon::bytes_sent.add(OSGetCoreId(), result);
     return result;
 }
 
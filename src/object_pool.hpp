@@ -0,0 +1,137 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Lock-free object pool
+ *
+ * A fixed number of slots, preallocated inside the object. The free slots form a stack
+ * (a Treiber stack), linked by index; the head packs the top index with a tag that
+ * changes on every push, so a thread that got preempted in the middle of a pop can't be
+ * fooled by the same index coming back (the ABA problem). Everything is 32-bit, so it
+ * only needs the atomics the PowerPC 750 has.
+ *
+ * Any thread can create or destroy objects. When all slots are in use, create() returns
+ * nullptr, and the failure is counted.
+ *
+ * tools/test-object-pool.cpp stresses it with concurrent creates and destroys.
+ */
+
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+
+namespace utils {
+
+    template<typename T,
+             std::uint16_t Capacity>
+    struct object_pool {
+
+        static_assert(Capacity > 0 && Capacity < 0xffff);
+
+        static constexpr std::uint16_t nil = 0xffff;
+
+        struct alignas(T) slot {
+            std::byte storage[sizeof(T)];
+        };
+
+        std::array<slot, Capacity> slots;
+        std::array<std::atomic_uint16_t, Capacity> next;
+        // Low 16 bits: index of the top free slot; high 16 bits: tag.
+        std::atomic_uint32_t head;
+
+        std::atomic_uint32_t in_use = 0;
+        std::atomic_uint32_t peak = 0;
+        // Calls to create() that found no free slot.
+        std::atomic_uint32_t exhausted = 0;
+
+
+        object_pool()
+            noexcept
+        {
+            for (std::uint16_t i = 0; i < Capacity; ++i)
+                next[i].store(i + 1 < Capacity ? i + 1 : nil, std::memory_order_relaxed);
+            head.store(0, std::memory_order_relaxed);
+        }
+
+
+        // Not safe to call while another thread might be using the pool.
+        void
+        reset_stats()
+            noexcept
+        {
+            peak.store(in_use.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            exhausted.store(0, std::memory_order_relaxed);
+        }
+
+
+        template<typename... Args>
+        T*
+        create(Args&&... args)
+        {
+            std::uint32_t old = head.load(std::memory_order_acquire);
+            std::uint16_t idx;
+            for (;;) {
+                idx = old & 0xffff;
+                if (idx == nil) {
+                    exhausted.fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                // If another thread took this slot meanwhile, this value might be stale;
+                // then the tag will have changed, and the exchange fails.
+                const std::uint16_t succ = next[idx].load(std::memory_order_relaxed);
+                const std::uint32_t desired = (old & 0xffff0000) | succ;
+                if (head.compare_exchange_weak(old, desired,
+                                               std::memory_order_acquire,
+                                               std::memory_order_acquire))
+                    break;
+            }
+
+            const std::uint32_t n = in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+            std::uint32_t p = peak.load(std::memory_order_relaxed);
+            while (n > p && !peak.compare_exchange_weak(p, n, std::memory_order_relaxed))
+                ;
+
+            return new (slots[idx].storage) T(std::forward<Args>(args)...);
+        }
+
+
+        // The object must have come from create() on this pool.
+        void
+        destroy(T* obj)
+            noexcept
+        {
+            if (!obj)
+                return;
+            obj->~T();
+            const auto idx = static_cast<std::uint16_t>(reinterpret_cast<slot*>(obj)
+                                                        - slots.data());
+            std::uint32_t old = head.load(std::memory_order_relaxed);
+            for (;;) {
+                next[idx].store(old & 0xffff, std::memory_order_relaxed);
+                // Bump the tag on every push.
+                const std::uint32_t desired = ((old + 0x10000) & 0xffff0000) | idx;
+                if (head.compare_exchange_weak(old, desired,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed))
+                    break;
+            }
+            in_use.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+    };
+
+} // namespace utils
+
+#endif
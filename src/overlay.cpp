@@ -15,13 +15,23 @@
  * notification requires locking one or more mutexes in the Notification module; not a
  * good thing to have hooked into `GX2SwapScanBuffers()`.
  *
- * This will be later replaced by an actual overlay rendering implementation, requiring no
- * mutexes. Then we can have more advanced rendering, like line graphs and histograms.
+ * To keep those mutexes out of the rendering thread, by default `render()` only writes the
+ * composed text into a lock-free triple buffer; a low priority "publisher" thread, owned
+ * by the plugin, picks it up and updates the notification, skipping the update entirely
+ * when the text didn't change.
+ *
+ * Alternatively, the "native" renderer (see gx2_overlay.cpp) draws the HUD directly into
+ * the game's frames, requiring no mutexes and no Notification module at all. Later we can
+ * have more advanced rendering there, like line graphs and histograms.
  */
 
 #include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <string>
 
+#include <coreinit/mutex.h>
+#include <coreinit/thread.h>
 #include <coreinit/time.h>
 
 #include <notifications/notifications.h>
@@ -32,11 +42,17 @@
 #include "cpu_mon.hpp"
 #include "fs_mon.hpp"
 #include "gx2_mon.hpp"
+#include "gx2_overlay.hpp"
 #include "logger.hpp"
 #include "net_mon.hpp"
 #include "nintendo_glyphs.h"
 #include "pad_mon.hpp"
 #include "time_mon.hpp"
+#include "triple_buffer.hpp"
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
 
 
 // #define TEST_TIME
@@ -49,6 +65,10 @@ namespace overlay {
 
     std::atomic<NotificationModuleHandle> notif_handle{0};
 
+    // Held by the publisher thread while it might be using notif_handle. A mutex, not a
+    // spin: the publisher has a low priority, and yielding wouldn't let it run.
+    OSMutex publish_mutex;
+
     OSTime last_sample_time;
 
 
@@ -68,13 +88,165 @@ namespace overlay {
             return {c.r, c.g, c.b, c.a};
         }
 
+
+        void
+        finish_notification()
+        {
+            // Take the handle away first, then wait for any update that might still be
+            // using it; after that, the publisher thread can't see it anymore.
+            auto handle = notif_handle.exchange(0);
+            if (!handle)
+                return;
+            OSLockMutex(&publish_mutex);
+            OSUnlockMutex(&publish_mutex);
+
+            auto status = NotificationModule_FinishDynamicNotification(handle, 0);
+            if (status != NOTIFICATION_MODULE_RESULT_SUCCESS) {
+                logger::printf("Failed to finish notification: %s\n",
+                               NotificationModule_GetStatusStr(status));
+                return;
+            }
+        }
+
     }
 
 
+    namespace publisher {
+
+        struct text_slot {
+            char text[512];
+        };
+
+        utils::triple_buffer<text_slot> buffer;
+
+        // How often the publisher thread looks for new text.
+        const std::uint32_t poll_period_ms = 16;
+
+        // Lower priority than most game threads (0 is the highest, 31 the lowest).
+        const std::int32_t thread_priority = 24;
+
+        OSThread thread;
+        alignas(16) std::uint8_t thread_stack[16 * 1024];
+        bool thread_created = false;
+        std::atomic_bool quit_requested = false;
+
+
+        void
+        pin_to_least_busy_core()
+        {
+            unsigned core = cpu_mon::get_least_busy_core();
+            if (!OSSetThreadAffinity(OSGetCurrentThread(),
+                                     OS_THREAD_ATTRIB_AFFINITY_CPU0 << core)) {
+                logger::printf("Failed to move publisher thread to core %u.\n", core);
+                return;
+            }
+            logger::printf("Publisher thread running on core %u.\n", core);
+        }
+
+
+        int
+        thread_main(int, const char**)
+        {
+            // This is only touched by this thread.
+            static char last_text[sizeof text_slot::text];
+            NotificationModuleHandle last_handle = 0;
+            bool pinned = false;
+
+            while (!quit_requested) {
+                OSSleepTicks(OSMillisecondsToTicks(poll_period_ms));
+
+                auto handle = notif_handle.load();
+                if (!handle)
+                    continue;
+
+                // A new notification starts out with no text.
+                if (handle != last_handle) {
+                    last_handle = handle;
+                    last_text[0] = '\0';
+                }
+
+                const text_slot* slot = buffer.consume();
+                if (!slot)
+                    continue;
+
+                if (!std::strcmp(slot->text, last_text))
+                    continue;
+
+                // At application start the game's threads don't exist yet, so the core
+                // is only picked once there's something to publish.
+                if (!pinned) {
+                    pin_to_least_busy_core();
+                    pinned = true;
+                }
+
+                std::strcpy(last_text, slot->text);
+                OSLockMutex(&publish_mutex);
+                // Check again, finish_notification() might have taken it meanwhile.
+                if (notif_handle == handle)
+                    NotificationModule_UpdateDynamicNotificationText(handle, last_text);
+                OSUnlockMutex(&publish_mutex);
+            }
+
+            return 0;
+        }
+
+
+        void
+        start()
+        {
+            if (thread_created)
+                return;
+
+            quit_requested = false;
+
+            // Moved to the least busy core later, see thread_main().
+            if (!OSCreateThread(&thread,
+                                thread_main,
+                                0, nullptr,
+                                thread_stack + sizeof thread_stack,
+                                sizeof thread_stack,
+                                thread_priority,
+                                OS_THREAD_ATTRIB_AFFINITY_ANY)) {
+                logger::printf("Failed to create publisher thread.\n");
+                return;
+            }
+            OSSetThreadName(&thread, PACKAGE_NAME " publisher");
+            OSResumeThread(&thread);
+            thread_created = true;
+        }
+
+
+        void
+        stop()
+        {
+            if (!thread_created)
+                return;
+
+            quit_requested = true;
+            OSJoinThread(&thread, nullptr);
+            thread_created = false;
+        }
+
+
+        // Called from the rendering thread: never blocks, never locks.
+        void
+        submit(const std::string& text)
+        {
+            text_slot& slot = buffer.write_slot();
+            auto len = text.copy(slot.text, sizeof slot.text - 1);
+            slot.text[len] = '\0';
+            buffer.publish();
+        }
+
+    } // namespace publisher
+
+
     void
     initialize()
     {
+        OSInitMutex(&publish_mutex);
         NotificationModule_InitLibrary();
+        gx2_overlay::initialize();
     }
 
 
@@ -86,6 +258,21 @@ namespace overlay {
     }
 
 
+    void
+    on_application_start()
+    {
+        gx2_overlay::on_application_start();
+        publisher::start();
+    }
+
+
+    void
+    on_application_ends()
+    {
+        publisher::stop();
+    }
+
+
     void
     create_or_reset()
     {
@@ -93,6 +280,15 @@ namespace overlay {
         if (!gx2_init)
             return;
 
+        if (cfg::native_overlay && !gx2_overlay::is_unsupported()) {
+            finish_notification();
+            gx2_overlay::create();
+            reset();
+            return;
+        }
+
+        gx2_overlay::destroy();
+
         auto handle = notif_handle.load();
         if (!handle) {
             auto status = NotificationModule_AddDynamicNotificationEx(NIN_GLYPH_HELP,
@@ -124,16 +320,25 @@ namespace overlay {
         fs_mon::finalize();
         pad_mon::finalize();
 
-        auto handle = notif_handle.load();
-        if (!handle)
-            return;
+        gx2_overlay::destroy();
+        finish_notification();
+    }
 
-        auto status = NotificationModule_FinishDynamicNotification(handle, 0);
-        if (status != NOTIFICATION_MODULE_RESULT_SUCCESS) {
-            logger::printf("Failed to finish notification: %s\n",
-                           NotificationModule_GetStatusStr(status));
-            return;
-        }
+
+    // Like destroy(), but the GPU profiler keeps its state, so turning the HUD back on
+    // doesn't start from scratch; only what it had open is closed.
+    void
+    hide()
+    {
+        time_mon::finalize();
+        gx2_mon::pause();
+        cpu_mon::finalize();
+        net_mon::finalize();
+        fs_mon::finalize();
+        pad_mon::finalize();
+
+        gx2_overlay::destroy();
+        finish_notification();
     }
 
 
@@ -171,8 +376,8 @@ namespace overlay {
     void
     on_release_foreground()
     {
+        // Note: gx2_mon keeps its state while in the background, see gx2_mon::reset().
         time_mon::finalize();
-        gx2_mon::finalize();
         cpu_mon::finalize();
         net_mon::finalize();
         fs_mon::finalize();
@@ -183,8 +388,13 @@ namespace overlay {
     void
     render()
     {
+        // The native renderer gave up on this game's color buffers.
+        if (gx2_overlay::is_created() && gx2_overlay::is_unsupported())
+            create_or_reset();
+
+        const bool native = gx2_overlay::is_created();
         auto handle = notif_handle.load();
-        if (!handle)
+        if (!handle && !native)
             return;
 
         const OSTime update_interval = OSMillisecondsToTicks(cfg::interval.count());
@@ -211,12 +421,78 @@ namespace overlay {
                 sep = " | ";
             }
 
+            if (cfg::gpu_targets) {
+                text += sep;
+                text += gx2_mon::targets::get_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::gpu_present) {
+                text += sep;
+                text += gx2_mon::present::get_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::gpu_time) {
+                text += sep;
+                text += gx2_mon::timing::get_report(dt);
+                sep = " | ";
+            }
+
             if (cfg::gpu_busy) {
                 text += sep;
                 text += gx2_mon::perf::get_report(dt);
                 sep = " | ";
             }
 
+            if (cfg::gpu_bandwidth) {
+                text += sep;
+                text += gx2_mon::perf::get_bandwidth_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::gpu_stages) {
+                text += sep;
+                text += gx2_mon::perf::get_stages_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::gpu_passes) {
+                text += sep;
+                text += gx2_mon::passes::get_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::gpu_bottleneck) {
+                text += sep;
+                text += gx2_mon::bottleneck::get_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::swap_wait) {
+                text += sep;
+                text += gx2_mon::frame_split::get_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::gpu_stalls) {
+                text += sep;
+                text += gx2_mon::stalls::get_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::gpu_draws) {
+                text += sep;
+                text += gx2_mon::draws::get_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::gpu_vram) {
+                text += sep;
+                text += gx2_mon::vram::get_report(dt);
+                sep = " | ";
+            }
+
             if (cfg::cpu_busy) {
                 text += sep;
                 text += cpu_mon::get_report(dt);
@@ -235,6 +511,18 @@ namespace overlay {
                 sep = " | ";
             }
 
+            if (cfg::fs_io) {
+                text += sep;
+                text += fs_mon::get_io_report(dt);
+                sep = " | ";
+            }
+
+            if (cfg::fs_hot) {
+                text += sep;
+                text += fs_mon::get_hot_report(dt);
+                sep = " | ";
+            }
+
             if (cfg::button_rate) {
                 text += sep;
                 text += pad_mon::get_report(dt);
@@ -245,7 +533,12 @@ namespace overlay {
             if (text.empty())
                 text = NIN_GLYPH_HELP;
 
-            NotificationModule_UpdateDynamicNotificationText(handle, text.c_str());
+            if (native)
+                gx2_overlay::update(text);
+            else if (cfg::threaded_update && publisher::thread_created)
+                publisher::submit(text);
+            else
+                NotificationModule_UpdateDynamicNotificationText(handle, text.c_str());
 
             last_sample_time = now;
 
@@ -279,7 +572,7 @@ namespace overlay {
         if (cfg::enabled)
             overlay::create_or_reset();
         else
-            overlay::destroy();
+            overlay::hide();
     }
 
 }
@@ -19,8 +19,12 @@ namespace overlay {
     void initialize();
     void finalize();
 
+    void on_application_start();
+    void on_application_ends();
+
     void create_or_reset();
     void destroy();
+    void hide();
     void reset();
 
 
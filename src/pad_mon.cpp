@@ -11,12 +11,12 @@
  */
 
 #include <array>
-#include <atomic>
 #include <bit>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 
+#include <coreinit/core.h>      // OSGetCoreId()
 #include <coreinit/thread.h>
 #include <padscore/kpad.h>
 #include <padscore/wpad.h>
@@ -28,6 +28,7 @@
 #include "cfg.hpp"
 #include "logger.hpp"
 #include "overlay.hpp"
+#include "sharded_counter.hpp"
 
 
 using std::array;
@@ -39,7 +40,7 @@ using std::uint16_t;
 namespace pad_mon {
 
 
-    std::atomic_uint button_presses = 0;
+    utils::sharded_counter<> button_presses;
 
 
     void
@@ -57,7 +58,7 @@ namespace pad_mon {
     void
     reset()
     {
-        button_presses = 0;
+        button_presses.clear();
     }
 
 
@@ -66,7 +67,7 @@ namespace pad_mon {
     {
         static char buf[64];
 
-        const unsigned presses = std::atomic_exchange(&button_presses, 0u);
+        const float presses = button_presses.take();
 
         const float presses_rate = presses / dt;
 
@@ -133,7 +134,7 @@ namespace pad_mon {
                 counter += std::popcount(buf[idx].trigger & vpad_mask);
 
             if (counter)
-                button_presses += counter;
+                button_presses.add(OSGetCoreId(), counter);
         }
 
         return result;
@@ -182,7 +183,7 @@ namespace pad_mon {
                     counter += std::popcount(ext->trigger);
 
                 if (counter)
-                    button_presses += counter;
+                    button_presses.add(OSGetCoreId(), counter);
             }
         }
 
@@ -0,0 +1,142 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Pointer map
+ *
+ * A fixed-capacity hash map from pointers to small values, using open addressing with
+ * linear probing. All the memory is inside the object, so inserting never allocates.
+ * Erasing shifts the following entries back, so no tombstones ever pile up.
+ *
+ * tools/test-ptr-map.cpp checks it against std::unordered_map.
+ */
+
+#ifndef PTR_MAP_HPP
+#define PTR_MAP_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+
+namespace utils {
+
+    template<typename V,
+             std::size_t Capacity>
+    struct ptr_map {
+
+        static_assert(std::has_single_bit(Capacity));
+
+        // Beyond this, probe sequences get too long, so inserting fails.
+        static constexpr std::size_t max_size = Capacity / 4 * 3;
+
+        struct entry {
+            std::uintptr_t key; // 0 means empty
+            V              value;
+        };
+
+        std::array<entry, Capacity> entries{};
+        std::size_t size = 0;
+
+
+        static
+        std::size_t
+        home(std::uintptr_t key)
+            noexcept
+        {
+            // Pointers are aligned, so mix the high bits into the low ones.
+            std::uint64_t h = key;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            return h & (Capacity - 1);
+        }
+
+
+        void
+        clear()
+            noexcept
+        {
+            entries.fill({});
+            size = 0;
+        }
+
+
+        V*
+        find(const void* ptr)
+            noexcept
+        {
+            const auto key = reinterpret_cast<std::uintptr_t>(ptr);
+            for (std::size_t i = home(key); entries[i].key; i = (i + 1) & (Capacity - 1))
+                if (entries[i].key == key)
+                    return &entries[i].value;
+            return nullptr;
+        }
+
+
+        // Replaces the value if the key is already there. Returns false when full.
+        bool
+        insert(const void* ptr, const V& value)
+            noexcept
+        {
+            const auto key = reinterpret_cast<std::uintptr_t>(ptr);
+            if (!key)
+                return false;
+            std::size_t i = home(key);
+            for (; entries[i].key; i = (i + 1) & (Capacity - 1))
+                if (entries[i].key == key) {
+                    entries[i].value = value;
+                    return true;
+                }
+            if (size >= max_size)
+                return false;
+            entries[i] = {key, value};
+            ++size;
+            return true;
+        }
+
+
+        std::optional<V>
+        erase(const void* ptr)
+            noexcept
+        {
+            const auto key = reinterpret_cast<std::uintptr_t>(ptr);
+            if (!key)
+                return {};
+            std::size_t i = home(key);
+            for (; entries[i].key != key; i = (i + 1) & (Capacity - 1))
+                if (!entries[i].key)
+                    return {};
+
+            V value = entries[i].value;
+
+            // Move back every following entry that can't be found anymore past the hole.
+            for (std::size_t j = (i + 1) & (Capacity - 1);
+                 entries[j].key;
+                 j = (j + 1) & (Capacity - 1)) {
+                const std::size_t h = home(entries[j].key);
+                // Distance from the entry's home slot, to the hole and to where it is.
+                const std::size_t to_hole = (i - h) & (Capacity - 1);
+                const std::size_t to_here = (j - h) & (Capacity - 1);
+                if (to_hole < to_here) {
+                    entries[i] = entries[j];
+                    i = j;
+                }
+            }
+            entries[i] = {};
+            --size;
+            return value;
+        }
+
+    };
+
+} // namespace utils
+
+#endif
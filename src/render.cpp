@@ -0,0 +1,359 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Overlay rendering
+ *
+ * Text is laid out into a draw list of quads, all sampling from a glyph atlas that is
+ * baked once. The software rasterizer here blends a draw list into any RGBA framebuffer;
+ * the GX2 backend (in gx2_overlay.cpp) uses it to fill a GPU surface, that gets copied
+ * into the game's color buffer.
+ *
+ * Nothing in here depends on WUT, so layout and blitting can be tested and benchmarked
+ * on the host (see tools/test-render.cpp).
+ */
+
+#include <algorithm>            // max(), min(), fill()
+
+#include "render.hpp"
+
+#include "font_5x7.h"
+
+
+namespace render {
+
+    namespace {
+
+        // Non-ASCII glyphs, stored after the ASCII ones in the atlas.
+        const unsigned first_bar = 95;     // U+2581 to U+2588
+        const unsigned arrow_up = 103;     // U+2191
+        const unsigned arrow_down = 104;   // U+2193
+        const unsigned corner = 105;       // U+2514
+        const unsigned plus_minus = 106;   // U+00B1
+        const unsigned help = 107;         // U+E06B, NIN_GLYPH_HELP
+
+        const std::uint8_t arrow_up_cols[5]   = {0x04, 0x02, 0x7f, 0x02, 0x04};
+        const std::uint8_t arrow_down_cols[5] = {0x10, 0x20, 0x7f, 0x20, 0x10};
+        const std::uint8_t corner_cols[5]     = {0x0f, 0x08, 0x08, 0x08, 0x08};
+        const std::uint8_t plus_minus_cols[5] = {0x40, 0x44, 0x4e, 0x44, 0x40};
+        // An inverted '?' in a rounded box.
+        const std::uint8_t help_cols[5]       = {0x3e, 0x7d, 0x55, 0x79, 0x3e};
+
+        // Marks a forced line break in the decoded text.
+        const std::uint16_t newline = 0xffff;
+
+
+        void
+        fill_texel(glyph_atlas& atlas,
+                   unsigned glyph,
+                   unsigned col,
+                   unsigned row)
+        {
+            const unsigned s = glyph_atlas::scale;
+            for (unsigned dy = 0; dy < s; ++dy) {
+                unsigned y = atlas.v(glyph) + row * s + dy;
+                for (unsigned dx = 0; dx < s; ++dx) {
+                    unsigned x = atlas.u(glyph) + col * s + dx;
+                    atlas.alpha[y * glyph_atlas::width + x] = 0xff;
+                }
+            }
+        }
+
+
+        void
+        bake_columns(glyph_atlas& atlas,
+                     unsigned glyph,
+                     const std::uint8_t* cols)
+        {
+            for (unsigned col = 0; col < 5; ++col)
+                for (unsigned row = 0; row < 7; ++row)
+                    if (cols[col] & (1u << row))
+                        fill_texel(atlas, glyph, col, row);
+        }
+
+
+        // Decodes one code point, advancing pos; invalid sequences decode as '?'.
+        char32_t
+        decode_utf8(std::string_view text, std::size_t& pos)
+        {
+            unsigned char c = text[pos++];
+            if (c < 0x80)
+                return c;
+
+            unsigned extra;
+            char32_t cp;
+            if ((c & 0xe0) == 0xc0) {
+                extra = 1;
+                cp = c & 0x1f;
+            } else if ((c & 0xf0) == 0xe0) {
+                extra = 2;
+                cp = c & 0x0f;
+            } else if ((c & 0xf8) == 0xf0) {
+                extra = 3;
+                cp = c & 0x07;
+            } else
+                return U'?';
+
+            for (unsigned i = 0; i < extra; ++i) {
+                if (pos >= text.size())
+                    return U'?';
+                unsigned char cc = text[pos];
+                if ((cc & 0xc0) != 0x80)
+                    return U'?';
+                cp = (cp << 6) | (cc & 0x3f);
+                ++pos;
+            }
+            return cp;
+        }
+
+
+        rgba
+        blend(rgba src, unsigned a, rgba dst)
+            noexcept
+        {
+            rgba result = 0;
+            for (unsigned shift = 8; shift < 32; shift += 8) {
+                unsigned s = (src >> shift) & 0xff;
+                unsigned d = (dst >> shift) & 0xff;
+                unsigned c = (s * a + d * (255 - a) + 127) / 255;
+                result |= c << shift;
+            }
+            unsigned da = dst & 0xff;
+            result |= a + (da * (255 - a) + 127) / 255;
+            return result;
+        }
+
+    } // namespace
+
+
+    void
+    glyph_atlas::bake()
+    {
+        alpha.fill(0);
+
+        for (unsigned c = FONT_5X7_FIRST; c <= FONT_5X7_LAST; ++c)
+            bake_columns(*this, c - FONT_5X7_FIRST, font_5x7[c - FONT_5X7_FIRST]);
+
+        // Eighth blocks: bar k fills the bottom k rows of the 8-row cell.
+        for (unsigned k = 1; k <= 8; ++k)
+            for (unsigned col = 0; col < 5; ++col)
+                for (unsigned row = 8 - k; row < 8; ++row)
+                    fill_texel(*this, first_bar + k - 1, col, row);
+
+        bake_columns(*this, arrow_up, arrow_up_cols);
+        bake_columns(*this, arrow_down, arrow_down_cols);
+        bake_columns(*this, corner, corner_cols);
+        bake_columns(*this, plus_minus, plus_minus_cols);
+        bake_columns(*this, help, help_cols);
+    }
+
+
+    unsigned
+    glyph_atlas::lookup(char32_t cp)
+        const noexcept
+    {
+        if (cp >= FONT_5X7_FIRST && cp <= FONT_5X7_LAST)
+            return cp - FONT_5X7_FIRST;
+        if (cp >= U'▁' && cp <= U'█')
+            return first_bar + (cp - U'▁');
+        switch (cp) {
+        case U'↑':
+            return arrow_up;
+        case U'↓':
+            return arrow_down;
+        case U'└':
+            return corner;
+        case U'±':
+            return plus_minus;
+        case U'\ue06b':
+            return help;
+        case U'　':
+            return space;
+        default:
+            return '?' - FONT_5X7_FIRST;
+        }
+    }
+
+
+    void
+    draw_list::clear()
+        noexcept
+    {
+        size = 0;
+        width = 0;
+        height = 0;
+    }
+
+
+    bool
+    draw_list::add_rect(int x, int y,
+                        unsigned w, unsigned h,
+                        rgba color)
+        noexcept
+    {
+        if (size >= capacity)
+            return false;
+        quads[size++] = quad{
+            .x = static_cast<std::int16_t>(x),
+            .y = static_cast<std::int16_t>(y),
+            .w = static_cast<std::uint16_t>(w),
+            .h = static_cast<std::uint16_t>(h),
+            .u = 0,
+            .v = 0,
+            .color = color,
+            .textured = false
+        };
+        width = std::max<int>(width, x + w);
+        height = std::max<int>(height, y + h);
+        return true;
+    }
+
+
+    bool
+    draw_list::add_glyph(const glyph_atlas& atlas,
+                         int x, int y,
+                         unsigned glyph,
+                         rgba color)
+        noexcept
+    {
+        if (size >= capacity)
+            return false;
+        quads[size++] = quad{
+            .x = static_cast<std::int16_t>(x),
+            .y = static_cast<std::int16_t>(y),
+            .w = glyph_atlas::cell_width,
+            .h = glyph_atlas::cell_height,
+            .u = static_cast<std::uint16_t>(atlas.u(glyph)),
+            .v = static_cast<std::uint16_t>(atlas.v(glyph)),
+            .color = color,
+            .textured = true
+        };
+        width = std::max<int>(width, x + glyph_atlas::cell_width);
+        height = std::max<int>(height, y + glyph_atlas::cell_height);
+        return true;
+    }
+
+
+    void
+    layout_text(draw_list& list,
+                const glyph_atlas& atlas,
+                std::string_view text,
+                unsigned max_width,
+                rgba fg,
+                rgba bg)
+    {
+        const unsigned pad = 4;
+        const unsigned cw = glyph_atlas::cell_width;
+        const unsigned ch = glyph_atlas::cell_height;
+        const unsigned limit = std::max(max_width, 2 * pad + cw) - pad;
+
+        // Note: static to avoid allocations, this is only called from one thread.
+        static std::array<std::uint16_t, 512> glyphs;
+        unsigned n = 0;
+        for (std::size_t pos = 0; pos < text.size() && n < glyphs.size();) {
+            char32_t cp = decode_utf8(text, pos);
+            glyphs[n++] = cp == U'\n' ? newline : atlas.lookup(cp);
+        }
+
+        list.clear();
+        // The background goes first, its size is only known after the layout is done.
+        list.add_rect(0, 0, 0, 0, bg);
+
+        unsigned x = pad;
+        unsigned y = pad;
+        unsigned right = pad;
+        for (unsigned i = 0; i < n;) {
+            if (glyphs[i] == newline) {
+                x = pad;
+                y += ch;
+                ++i;
+                continue;
+            }
+
+            if (glyphs[i] == glyph_atlas::space) {
+                // Spaces are only advanced over, and dropped at the start of a line.
+                if (x > pad)
+                    x += cw;
+                ++i;
+                continue;
+            }
+
+            unsigned end = i;
+            while (end < n && glyphs[end] != glyph_atlas::space && glyphs[end] != newline)
+                ++end;
+
+            // Move the whole word to the next line, if it doesn't fit in this one.
+            if (x > pad && x + (end - i) * cw > limit) {
+                x = pad;
+                y += ch;
+            }
+
+            for (; i < end; ++i) {
+                // Words longer than a line get broken anywhere.
+                if (x > pad && x + cw > limit) {
+                    x = pad;
+                    y += ch;
+                }
+                list.add_glyph(atlas, x, y, glyphs[i], fg);
+                x += cw;
+                right = std::max(right, x);
+            }
+        }
+
+        list.width = right + pad;
+        list.height = y + ch + pad;
+        list.quads[0].w = list.width;
+        list.quads[0].h = list.height;
+    }
+
+
+    void
+    clear(framebuffer& fb, rgba color)
+        noexcept
+    {
+        for (unsigned y = 0; y < fb.height; ++y) {
+            rgba* row = fb.pixels + y * fb.pitch;
+            std::fill(row, row + fb.width, color);
+        }
+    }
+
+
+    void
+    rasterize(const draw_list& list,
+              const glyph_atlas& atlas,
+              framebuffer& fb)
+        noexcept
+    {
+        for (unsigned i = 0; i < list.size; ++i) {
+            const quad& q = list.quads[i];
+
+            const int x0 = std::max<int>(q.x, 0);
+            const int y0 = std::max<int>(q.y, 0);
+            const int x1 = std::min<int>(q.x + q.w, fb.width);
+            const int y1 = std::min<int>(q.y + q.h, fb.height);
+            const unsigned color_a = q.color & 0xff;
+
+            for (int y = y0; y < y1; ++y) {
+                rgba* row = fb.pixels + y * fb.pitch;
+                const std::uint8_t* texels = nullptr;
+                if (q.textured)
+                    texels = atlas.alpha.data()
+                        + (q.v + y - q.y) * glyph_atlas::width + q.u;
+                for (int x = x0; x < x1; ++x) {
+                    unsigned a = color_a;
+                    if (texels)
+                        a = a * texels[x - q.x] / 255;
+                    if (!a)
+                        continue;
+                    row[x] = blend(q.color, a, row[x]);
+                }
+            }
+        }
+    }
+
+} // namespace render
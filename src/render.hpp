@@ -0,0 +1,133 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+
+namespace render {
+
+    // Colors are packed as 0xRRGGBBAA.
+    using rgba = std::uint32_t;
+
+
+    struct glyph_atlas {
+
+        // Every glyph from the 5x7 font sits in a 6x8 cell, scaled up.
+        static constexpr unsigned scale = 2;
+        static constexpr unsigned cell_width = 6 * scale;
+        static constexpr unsigned cell_height = 8 * scale;
+
+        // Printable ASCII, plus the few non-ASCII glyphs the monitors use.
+        static constexpr unsigned num_glyphs = 95 + 13;
+
+        static constexpr unsigned columns = 16;
+        static constexpr unsigned rows = (num_glyphs + columns - 1) / columns;
+        static constexpr unsigned width = columns * cell_width;
+        static constexpr unsigned height = rows * cell_height;
+
+        // Glyphs that have no visible pixels.
+        static constexpr unsigned space = 0;
+
+        std::array<std::uint8_t, width * height> alpha;
+
+
+        void bake();
+
+        // Index of the glyph for a code point; unknown code points map to '?'.
+        unsigned lookup(char32_t cp) const noexcept;
+
+        unsigned
+        u(unsigned glyph)
+            const noexcept
+        {
+            return (glyph % columns) * cell_width;
+        }
+
+        unsigned
+        v(unsigned glyph)
+            const noexcept
+        {
+            return (glyph / columns) * cell_height;
+        }
+
+    };
+
+
+    struct quad {
+        std::int16_t  x;
+        std::int16_t  y;
+        std::uint16_t w;
+        std::uint16_t h;
+        // Texel coordinates in the atlas, only used when textured.
+        std::uint16_t u;
+        std::uint16_t v;
+        rgba          color;
+        bool          textured;
+    };
+
+
+    // All the quads for one frame, batched together.
+    struct draw_list {
+
+        static constexpr unsigned capacity = 1024;
+
+        std::array<quad, capacity> quads;
+        unsigned size = 0;
+
+        // Bounding box of everything in the list, starting at (0, 0).
+        unsigned width = 0;
+        unsigned height = 0;
+
+
+        void clear() noexcept;
+
+        bool add_rect(int x, int y,
+                      unsigned w, unsigned h,
+                      rgba color) noexcept;
+
+        bool add_glyph(const glyph_atlas& atlas,
+                       int x, int y,
+                       unsigned glyph,
+                       rgba color) noexcept;
+
+    };
+
+
+    // Lays out UTF-8 text over a background box, wrapping words at max_width pixels.
+    void layout_text(draw_list& list,
+                     const glyph_atlas& atlas,
+                     std::string_view text,
+                     unsigned max_width,
+                     rgba fg,
+                     rgba bg);
+
+
+    struct framebuffer {
+        rgba*    pixels;
+        unsigned width;
+        unsigned height;
+        unsigned pitch; // in pixels
+    };
+
+
+    void clear(framebuffer& fb, rgba color) noexcept;
+
+
+    // Software rasterizer: alpha-blends every quad in the list into the framebuffer.
+    void rasterize(const draw_list& list,
+                   const glyph_atlas& atlas,
+                   framebuffer& fb) noexcept;
+
+} // namespace render
+
+#endif
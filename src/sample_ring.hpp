@@ -0,0 +1,278 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Sample rings and streaming statistics
+ *
+ * running_stats keeps the count, mean, variance (using Welford's method), min, max and
+ * last value of a stream of samples, without storing them.
+ *
+ * sample_ring keeps the last N samples in a fixed array, for anything that needs the
+ * actual samples (worst frame, sliding quantiles), and feeds every sample to its own
+ * running_stats, that the consumer drains once per report.
+ *
+ * Both are meant to be used from a single thread.
+ *
+ * spsc_sample_ring is for samples produced in another thread: the producer only writes
+ * a slot and bumps the head, and never waits; the consumer copies the new samples out,
+ * then checks the head again, and drops the ones the producer could have overwritten in
+ * the meantime, counting them as dropped. Only one thread may push at a time.
+ *
+ * Nothing here allocates. tools/test-sample-ring.cpp checks the statistics against a
+ * two-pass computation, runs the SPSC ring against a producer thread, and times push()
+ * and take().
+ */
+
+#ifndef SAMPLE_RING_HPP
+#define SAMPLE_RING_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+
+namespace utils {
+
+    struct running_stats {
+
+        std::uint32_t count = 0;
+        float mean = 0;
+        float m2 = 0; // sum of squared differences from the mean
+        float min = 0;
+        float max = 0;
+        float last = 0;
+
+
+        void
+        clear()
+            noexcept
+        {
+            *this = {};
+        }
+
+
+        void
+        add(float x)
+            noexcept
+        {
+            if (!count)
+                min = max = x;
+            else {
+                if (x < min)
+                    min = x;
+                if (x > max)
+                    max = x;
+            }
+            last = x;
+            ++count;
+            const float delta = x - mean;
+            mean += delta / count;
+            m2 += delta * (x - mean);
+        }
+
+
+        // Sample variance.
+        float
+        variance()
+            const noexcept
+        {
+            return count < 2 ? 0 : m2 / (count - 1);
+        }
+
+
+        float
+        stddev()
+            const noexcept
+        {
+            return std::sqrt(variance());
+        }
+
+
+        // Half-width of the 95% confidence interval for the mean.
+        float
+        confidence()
+            const noexcept
+        {
+            return count < 2 ? 0 : 1.96f * stddev() / std::sqrt(float(count));
+        }
+
+
+        // Returns the current stats, and clears them.
+        running_stats
+        take()
+            noexcept
+        {
+            running_stats result = *this;
+            clear();
+            return result;
+        }
+
+    };
+
+
+    template<typename T,
+             std::size_t N>
+    struct sample_ring {
+
+        static_assert(N > 0);
+
+        std::array<T, N> samples{};
+        std::size_t next = 0;
+        std::size_t size = 0;
+        // Every sample pushed since the last take().
+        running_stats stats;
+
+
+        void
+        clear()
+            noexcept
+        {
+            next = 0;
+            size = 0;
+            stats.clear();
+        }
+
+
+        bool
+        full()
+            const noexcept
+        {
+            return size == N;
+        }
+
+
+        // The sample that the next push() will overwrite, when full.
+        const T&
+        oldest()
+            const noexcept
+        {
+            return samples[full() ? next : 0];
+        }
+
+
+        void
+        push(const T& x)
+            noexcept
+        {
+            samples[next] = x;
+            next = (next + 1) % N;
+            if (size < N)
+                ++size;
+            stats.add(x);
+        }
+
+
+        // The stored samples, not in order.
+        std::span<const T>
+        view()
+            const noexcept
+        {
+            return {samples.data(), size};
+        }
+
+
+        running_stats
+        take()
+            noexcept
+        {
+            return stats.take();
+        }
+
+    };
+
+
+    template<typename T,
+             std::size_t N>
+    struct spsc_sample_ring {
+
+        static_assert(N > 0 && (N & (N - 1)) == 0);
+        static_assert(std::atomic<T>::is_always_lock_free);
+
+        std::array<std::atomic<T>, N> samples{};
+        std::atomic_uint32_t head = 0;  // only written by the producer
+        std::uint32_t tail = 0;         // only touched by the consumer
+        std::uint32_t dropped = 0;      // only touched by the consumer
+        running_stats stats;            // only touched by the consumer
+
+
+        // Producer: never blocks; when full, the oldest samples get overwritten.
+        void
+        push(const T& x)
+            noexcept
+        {
+            const std::uint32_t h = head.load(std::memory_order_relaxed);
+            // Keeps the previous head store ahead of the slot write, for drain()'s
+            // second look at the head.
+            std::atomic_thread_fence(std::memory_order_release);
+            samples[h & (N - 1)].store(x, std::memory_order_relaxed);
+            head.store(h + 1, std::memory_order_release);
+        }
+
+
+        // Consumer: moves all the new samples into stats, and returns how many there
+        // were. Samples the producer overwrote, before or during the copy, are counted
+        // as dropped instead.
+        std::uint32_t
+        drain()
+            noexcept
+        {
+            const std::uint32_t h = head.load(std::memory_order_acquire);
+            if (h - tail > N) {
+                dropped += h - tail - N;
+                tail = h - N;
+            }
+            const std::uint32_t n = h - tail;
+            std::array<T, N> copy;
+            for (std::uint32_t i = 0; i < n; ++i)
+                copy[i] = samples[(tail + i) & (N - 1)].load(std::memory_order_relaxed);
+
+            // If a copy saw a newer sample, this sees at least the head from when it
+            // was written. The producer might be writing sample `h2` right now, so
+            // everything up to `h2 - N` is suspect.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const std::uint32_t h2 = head.load(std::memory_order_relaxed);
+            std::uint32_t skip = 0;
+            if (h2 - tail >= N)
+                skip = std::min<std::uint32_t>(h2 - tail - N + 1, n);
+            dropped += skip;
+            for (std::uint32_t i = skip; i < n; ++i)
+                stats.add(copy[i]);
+            tail = h;
+            return n - skip;
+        }
+
+
+        // Consumer: drains, then returns the stats and clears them.
+        running_stats
+        take()
+            noexcept
+        {
+            drain();
+            return stats.take();
+        }
+
+
+        // Consumer: forgets every sample pushed so far.
+        void
+        clear()
+            noexcept
+        {
+            tail = head.load(std::memory_order_acquire);
+            dropped = 0;
+            stats.clear();
+        }
+
+    };
+
+} // namespace utils
+
+#endif
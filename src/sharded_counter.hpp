@@ -0,0 +1,91 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Sharded counter
+ *
+ * A counter that hooks on every core can increment without fighting over a cache line:
+ * each core adds to its own shard, in its own cache line, and the reader exchanges every
+ * shard with zero and adds them up in 64 bits.
+ *
+ * The shards are still atomic: threads on the same core can preempt each other in the
+ * middle of an add. But an atomic add on a cache line that no other core touches is
+ * cheap. The shards are 32-bit, since the PowerPC 750 has no 64-bit atomics; a single
+ * core would need to count over 4 GiB between two reports to overflow one.
+ *
+ * The caller picks the shard (e.g. with OSGetCoreId()), so tools/test-sharded-counter.cpp
+ * can run it with one host thread per shard.
+ */
+
+#ifndef SHARDED_COUNTER_HPP
+#define SHARDED_COUNTER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace utils {
+
+    // Espresso's cache lines are 32 bytes.
+    template<unsigned Shards = 3,
+             std::size_t LineSize = 32>
+    struct sharded_counter {
+
+        struct alignas(LineSize) shard {
+            std::atomic_uint32_t value = 0;
+        };
+
+        std::array<shard, Shards> shards;
+
+
+        void
+        add(unsigned idx, std::uint32_t n)
+            noexcept
+        {
+            shards[idx].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+
+        // Sum of everything added since the last take(), or clear().
+        std::uint64_t
+        take()
+            noexcept
+        {
+            std::uint64_t total = 0;
+            for (auto& s : shards)
+                total += s.value.exchange(0, std::memory_order_relaxed);
+            return total;
+        }
+
+
+        std::uint64_t
+        peek()
+            const noexcept
+        {
+            std::uint64_t total = 0;
+            for (auto& s : shards)
+                total += s.value.load(std::memory_order_relaxed);
+            return total;
+        }
+
+
+        void
+        clear()
+            noexcept
+        {
+            for (auto& s : shards)
+                s.value.store(0, std::memory_order_relaxed);
+        }
+
+    };
+
+} // namespace utils
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Size-class pool allocator
+ *
+ * A memory block is split evenly among a few size classes; each class is an array of
+ * fixed-size blocks, with a free list threaded through the free blocks. Allocating takes
+ * the first free block from the smallest class that fits (or the next one, if that's
+ * exhausted); freeing finds the class from the address. Both are O(1).
+ *
+ * It doesn't touch the memory beyond the free list, so tools/test-size-class-pool.cpp
+ * runs it over a plain malloc()'d block.
+ */
+
+#ifndef SIZE_CLASS_POOL_HPP
+#define SIZE_CLASS_POOL_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace utils {
+
+    struct size_class_pool {
+
+        static constexpr std::array<std::uint32_t, 5> class_sizes{32, 64, 128, 512, 2048};
+        static constexpr std::uint32_t max_block_size = class_sizes.back();
+
+        struct size_class {
+            std::uint32_t block_size = 0;
+            std::uint32_t num_blocks = 0;
+            std::byte*    begin = nullptr;
+            std::byte*    end = nullptr;
+            void*         free_list = nullptr;
+
+            std::uint32_t used = 0;
+            std::uint32_t peak = 0;
+            // Requests that best fit this class, but found no free block anywhere.
+            std::uint32_t failures = 0;
+        };
+
+        std::array<size_class, class_sizes.size()> classes;
+        // Requests larger than the largest class.
+        std::uint32_t oversize_failures = 0;
+
+
+        // The memory must be aligned to max_block_size; every block will be aligned to
+        // its own size.
+        void
+        init(void* memory, std::size_t size)
+            noexcept
+        {
+            oversize_failures = 0;
+            const std::size_t share = size / classes.size();
+            auto* pos = static_cast<std::byte*>(memory);
+            // Largest classes first, so alignment is kept.
+            for (std::size_t c = classes.size(); c-- > 0;) {
+                size_class& sc = classes[c];
+                sc = {};
+                sc.block_size = class_sizes[c];
+                sc.num_blocks = share / sc.block_size;
+                sc.begin = pos;
+                sc.end = pos + sc.num_blocks * sc.block_size;
+                for (std::uint32_t i = sc.num_blocks; i-- > 0;) {
+                    void* block = sc.begin + i * sc.block_size;
+                    *static_cast<void**>(block) = sc.free_list;
+                    sc.free_list = block;
+                }
+                pos = sc.end;
+            }
+        }
+
+
+        void*
+        alloc(std::size_t size)
+            noexcept
+        {
+            std::size_t c = 0;
+            while (c < classes.size() && class_sizes[c] < size)
+                ++c;
+            if (c == classes.size()) {
+                ++oversize_failures;
+                return nullptr;
+            }
+
+            for (std::size_t k = c; k < classes.size(); ++k) {
+                size_class& sc = classes[k];
+                if (!sc.free_list)
+                    continue;
+                void* block = sc.free_list;
+                sc.free_list = *static_cast<void**>(block);
+                if (++sc.used > sc.peak)
+                    sc.peak = sc.used;
+                return block;
+            }
+
+            ++classes[c].failures;
+            return nullptr;
+        }
+
+
+        // Returns false if the pointer doesn't belong to this pool.
+        bool
+        free(void* ptr)
+            noexcept
+        {
+            if (!ptr)
+                return true;
+            auto* p = static_cast<std::byte*>(ptr);
+            for (auto& sc : classes) {
+                if (p < sc.begin || p >= sc.end)
+                    continue;
+                *static_cast<void**>(ptr) = sc.free_list;
+                sc.free_list = ptr;
+                --sc.used;
+                return true;
+            }
+            return false;
+        }
+
+
+        std::size_t
+        bytes_used()
+            const noexcept
+        {
+            std::size_t total = 0;
+            for (auto& sc : classes)
+                total += std::size_t{sc.used} * sc.block_size;
+            return total;
+        }
+
+    };
+
+} // namespace utils
+
+#endif
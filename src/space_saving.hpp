@@ -0,0 +1,109 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Space-Saving heavy hitters
+ *
+ * Finds the keys with the most weight in a stream, using only K counters (Metwally et
+ * al., "Efficient Computation of Frequent and Top-k Elements in Data Streams"). A key
+ * that isn't tracked takes over the counter with the least weight, inheriting its weight
+ * as the possible error. Any key whose true weight is more than 1/K of the total is
+ * guaranteed to be tracked, and no count is ever underestimated.
+ *
+ * K is meant to be small, so the counters are just scanned. tools/test-space-saving.cpp
+ * checks both guarantees against exact counts.
+ */
+
+#ifndef SPACE_SAVING_HPP
+#define SPACE_SAVING_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+
+namespace utils {
+
+    template<typename Key,
+             std::size_t K>
+    struct space_saving {
+
+        static_assert(K > 0);
+
+        struct counter {
+            Key           key;
+            std::uint64_t count;
+            // How much of the count might belong to other keys.
+            std::uint64_t error;
+        };
+
+        std::array<counter, K> counters;
+        std::size_t size = 0;
+        std::uint64_t total = 0;
+
+
+        void
+        clear()
+            noexcept
+        {
+            size = 0;
+            total = 0;
+        }
+
+
+        void
+        add(const Key& key,
+            std::uint64_t weight)
+            noexcept
+        {
+            total += weight;
+
+            std::size_t min_idx = 0;
+            for (std::size_t i = 0; i < size; ++i) {
+                if (counters[i].key == key) {
+                    counters[i].count += weight;
+                    return;
+                }
+                if (counters[i].count < counters[min_idx].count)
+                    min_idx = i;
+            }
+
+            if (size < K) {
+                counters[size++] = {key, weight, 0};
+                return;
+            }
+
+            counter& victim = counters[min_idx];
+            victim.error = victim.count;
+            victim.key = key;
+            victim.count += weight;
+        }
+
+
+        // Copies the heaviest counters into out, heaviest first; returns how many.
+        std::size_t
+        top(std::span<counter> out)
+            const
+        {
+            const std::size_t n = std::min(out.size(), size);
+            std::partial_sort_copy(counters.begin(), counters.begin() + size,
+                                   out.begin(), out.begin() + n,
+                                   [](const counter& a, const counter& b)
+                                   {
+                                       return a.count > b.count;
+                                   });
+            return n;
+        }
+
+    };
+
+} // namespace utils
+
+#endif
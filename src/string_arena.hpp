@@ -0,0 +1,113 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * String arena
+ *
+ * Interns strings into a fixed buffer: each distinct string is copied only once, and is
+ * identified by a small integer from then on. A hash table of offsets (open addressing,
+ * linear probing) finds strings that are already there. Nothing is ever freed, except by
+ * clearing the whole arena; when it's full, interning fails, and the failure is counted.
+ */
+
+#ifndef STRING_ARENA_HPP
+#define STRING_ARENA_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+
+namespace utils {
+
+    template<std::size_t Size,
+             std::size_t Slots>
+    struct string_arena {
+
+        static_assert(std::has_single_bit(Slots));
+        static_assert(Size < 0xffffffff);
+
+        // Beyond this, probe sequences get too long, so interning fails.
+        static constexpr std::size_t max_strings = Slots / 4 * 3;
+
+        std::array<char, Size> data;
+        std::size_t used = 0;
+        // Offset + 1 of each string; 0 means empty.
+        std::array<std::uint32_t, Slots> table{};
+        std::size_t num_strings = 0;
+        // Strings that didn't fit.
+        std::uint32_t failures = 0;
+
+
+        static
+        std::uint32_t
+        hash(std::string_view str)
+            noexcept
+        {
+            // FNV-1a
+            std::uint32_t h = 2166136261u;
+            for (unsigned char c : str) {
+                h ^= c;
+                h *= 16777619u;
+            }
+            return h;
+        }
+
+
+        void
+        clear()
+            noexcept
+        {
+            used = 0;
+            table.fill(0);
+            num_strings = 0;
+            failures = 0;
+        }
+
+
+        // Returns the string's id, or 0 if it doesn't fit.
+        std::uint32_t
+        intern(std::string_view str)
+            noexcept
+        {
+            std::size_t i = hash(str) & (Slots - 1);
+            for (; table[i]; i = (i + 1) & (Slots - 1))
+                if (get(table[i]) == str)
+                    return table[i];
+
+            if (num_strings >= max_strings || Size - used < str.size() + 1) {
+                ++failures;
+                return 0;
+            }
+
+            std::memcpy(data.data() + used, str.data(), str.size());
+            data[used + str.size()] = '\0';
+            const auto id = static_cast<std::uint32_t>(used + 1);
+            used += str.size() + 1;
+            table[i] = id;
+            ++num_strings;
+            return id;
+        }
+
+
+        // The id must have come from intern(), and can't be 0.
+        const char*
+        get(std::uint32_t id)
+            const noexcept
+        {
+            return data.data() + id - 1;
+        }
+
+    };
+
+} // namespace utils
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Lock-free triple buffer
+ *
+ * One producer and one consumer exchange values without ever waiting on each other. The
+ * producer owns one slot, the consumer owns another, and the third slot sits in the
+ * middle; publishing or consuming is a single atomic exchange of the middle index.
+ *
+ * It doesn't use WUT; tools/test-triple-buffer.cpp runs the publisher's protocol over it
+ * on the host, with the notification calls stubbed out.
+ */
+
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+
+namespace utils {
+
+    template<typename T>
+    struct triple_buffer {
+
+        // Set in the middle index when it holds a value the consumer hasn't seen yet.
+        static constexpr std::uint32_t fresh_bit = 0x4;
+        static constexpr std::uint32_t index_mask = 0x3;
+
+        std::array<T, 3> slots{};
+        std::atomic_uint32_t middle{1};
+        std::uint32_t back = 0;  // only touched by the producer
+        std::uint32_t front = 2; // only touched by the consumer
+
+
+        // Producer: the slot to fill before calling publish().
+        T&
+        write_slot()
+            noexcept
+        {
+            return slots[back];
+        }
+
+
+        // Producer: hand the filled slot over to the consumer.
+        void
+        publish()
+            noexcept
+        {
+            auto old = middle.exchange(back | fresh_bit, std::memory_order_acq_rel);
+            back = old & index_mask;
+        }
+
+
+        // Consumer: returns the most recently published slot, or nullptr if nothing new
+        // was published since the last call.
+        const T*
+        consume()
+            noexcept
+        {
+            if (!(middle.load(std::memory_order_relaxed) & fresh_bit))
+                return nullptr;
+            auto old = middle.exchange(front, std::memory_order_acq_rel);
+            front = old & index_mask;
+            return &slots[front];
+        }
+
+
+        // Consumer: the last slot returned by consume().
+        const T&
+        read_slot()
+            const noexcept
+        {
+            return slots[front];
+        }
+
+    };
+
+} // namespace utils
+
+#endif
@@ -0,0 +1,504 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * I/O trace analyzer
+ *
+ * Reads a trace recorded by the plugin (see src/io_trace.hpp) and prints:
+ *
+ *   - a summary;
+ *   - read and write throughput over time;
+ *   - latency percentiles for each command;
+ *   - seek distances, and how much of the file access is sequential;
+ *   - the files with the most bytes read.
+ *
+ * This runs on the host (Linux), not on the Wii U.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io_trace.hpp"
+
+
+namespace {
+
+    using io_trace::record;
+
+
+    const char*
+    command_name(std::uint32_t command)
+    {
+        switch (command) {
+        case io_trace::cmd_open_dir:     return "open_dir";
+        case io_trace::cmd_read_dir:     return "read_dir";
+        case io_trace::cmd_close_dir:    return "close_dir";
+        case io_trace::cmd_open_file:    return "open";
+        case io_trace::cmd_read_file:    return "read";
+        case io_trace::cmd_write_file:   return "write";
+        case io_trace::cmd_get_pos_file: return "get_pos";
+        case io_trace::cmd_set_pos_file: return "set_pos";
+        case io_trace::cmd_is_eof:       return "is_eof";
+        case io_trace::cmd_stat_file:    return "stat";
+        case io_trace::cmd_close_file:   return "close";
+        case io_trace::cmd_get_info:     return "get_info";
+        case io_trace::cmd_raw_open:     return "raw_open";
+        case io_trace::cmd_raw_read:     return "raw_read";
+        case io_trace::cmd_raw_write:    return "raw_write";
+        case io_trace::cmd_raw_close:    return "raw_close";
+        default:                         return nullptr;
+        }
+    }
+
+
+    // Bytes transferred by a read or write; the status is the number of elements done.
+    std::uint64_t
+    transferred(const record& r)
+    {
+        if (r.status <= 0)
+            return 0;
+        return std::uint64_t{r.size} * static_cast<std::uint32_t>(r.status);
+    }
+
+
+    bool
+    is_read(std::uint32_t command)
+    {
+        return command == io_trace::cmd_read_file || command == io_trace::cmd_raw_read;
+    }
+
+
+    double
+    mib(std::uint64_t bytes)
+    {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+
+    struct interval_stats {
+        std::uint64_t read = 0;
+        std::uint64_t written = 0;
+        std::uint32_t requests = 0;
+    };
+
+
+    struct file_state {
+        std::string   path;
+        std::uint64_t pos = 0;
+        bool          known = false;
+    };
+
+
+    // Seek distances, in powers of 16.
+    const char* const seek_labels[] = {
+        "sequential",
+        "< 4 KiB",
+        "< 64 KiB",
+        "< 1 MiB",
+        "< 16 MiB",
+        ">= 16 MiB",
+    };
+    constexpr std::size_t num_seek_buckets = std::size(seek_labels);
+
+
+    std::size_t
+    seek_bucket(std::uint64_t distance)
+    {
+        if (!distance)
+            return 0;
+        std::size_t b = 1;
+        for (std::uint64_t limit = 4096;
+             b + 1 < num_seek_buckets && distance >= limit;
+             limit *= 16)
+            ++b;
+        return b;
+    }
+
+
+    // Time deltas come straight from the file, so a corrupt one could ask for any number
+    // of intervals; a record past this many is rejected.
+    constexpr std::size_t max_intervals = 1 << 20;
+
+
+    struct analysis {
+        io_trace::header header;
+        std::uint64_t    end_time = 0;
+        std::uint64_t    records = 0;
+        std::uint64_t    dropped = 0;
+        bool             complete = false;
+        bool             truncated = false;
+        bool             out_of_range = false;
+
+        std::uint64_t interval_us;
+        std::vector<interval_stats> intervals;
+
+        std::uint64_t total_read = 0;
+        std::uint64_t total_written = 0;
+        std::uint64_t errors = 0;
+
+        std::map<std::uint32_t, std::vector<std::uint32_t>> latencies;
+
+        std::unordered_map<std::uint32_t, file_state> files;
+        std::uint64_t seeks[num_seek_buckets] = {};
+        std::uint64_t backward_seeks = 0;
+        std::uint64_t seek_bytes[num_seek_buckets] = {};
+        std::uint64_t unknown_pos = 0;
+
+        std::unordered_map<std::string, std::uint64_t> bytes_per_path;
+
+
+        explicit
+        analysis(std::uint64_t interval_ms) :
+            interval_us{interval_ms * 1000}
+        {}
+
+
+        void
+        add_file_access(const record& r,
+                        std::uint64_t bytes)
+        {
+            auto& f = files[r.handle];
+            if (!f.path.empty() && is_read(r.command))
+                bytes_per_path[f.path] += bytes;
+
+            if (!r.has_offset && !f.known) {
+                ++unknown_pos;
+                return;
+            }
+            const std::uint64_t offset = r.has_offset ? r.offset : f.pos;
+            if (f.known) {
+                const std::uint64_t distance = offset >= f.pos
+                    ? offset - f.pos
+                    : f.pos - offset;
+                const auto b = seek_bucket(distance);
+                ++seeks[b];
+                seek_bytes[b] += bytes;
+                if (offset < f.pos)
+                    ++backward_seeks;
+            } else
+                ++unknown_pos;
+            f.pos = offset + bytes;
+            f.known = true;
+        }
+
+
+        // Returns false if the record is too far from the start.
+        bool
+        add(const record& r)
+        {
+            const std::uint64_t rel = r.time - header.start_time;
+            if (r.time < header.start_time || rel / interval_us >= max_intervals)
+                return false;
+
+            ++records;
+            end_time = r.time;
+
+            const std::size_t idx = rel / interval_us;
+            if (intervals.size() <= idx)
+                intervals.resize(idx + 1);
+            auto& iv = intervals[idx];
+            ++iv.requests;
+
+            latencies[r.command].push_back(r.latency);
+            if (r.status < 0)
+                ++errors;
+
+            switch (r.command) {
+
+            case io_trace::cmd_open_file:
+                if (r.status >= 0)
+                    files[r.handle] = {std::string{r.path}, 0, true};
+                break;
+
+            case io_trace::cmd_close_file:
+                files.erase(r.handle);
+                break;
+
+            case io_trace::cmd_set_pos_file:
+                if (r.status >= 0) {
+                    auto& f = files[r.handle];
+                    f.pos = r.offset;
+                    f.known = true;
+                }
+                break;
+
+            case io_trace::cmd_read_file:
+            case io_trace::cmd_write_file:
+                {
+                    const std::uint64_t bytes = transferred(r);
+                    if (r.command == io_trace::cmd_read_file) {
+                        iv.read += bytes;
+                        total_read += bytes;
+                    } else {
+                        iv.written += bytes;
+                        total_written += bytes;
+                    }
+                    if (r.status >= 0)
+                        add_file_access(r, bytes);
+                }
+                break;
+
+            case io_trace::cmd_raw_read:
+                iv.read += transferred(r);
+                total_read += transferred(r);
+                break;
+
+            case io_trace::cmd_raw_write:
+                iv.written += transferred(r);
+                total_written += transferred(r);
+                break;
+
+            }
+            return true;
+        }
+
+    };
+
+
+    void
+    print_summary(const analysis& a)
+    {
+        const double duration = (a.end_time - a.header.start_time) / 1e6;
+        std::printf("Title:     %016" PRIx64 "\n", a.header.title_id);
+        std::printf("Duration:  %.3f s\n", duration);
+        std::printf("Records:   %" PRIu64 "\n", a.records);
+        std::printf("Dropped:   %" PRIu64 "%s\n",
+                    a.dropped,
+                    a.complete ? "" : " (unknown: the end record wasn't reached)");
+        if (a.truncated)
+            std::printf("Warning:   the last record is truncated\n");
+        if (a.out_of_range)
+            std::printf("Warning:   stopped at a record more than %zu intervals in;"
+                        " the trace is corrupt, or --interval is too small\n",
+                        max_intervals);
+        std::printf("Read:      %.2f MiB\n", mib(a.total_read));
+        std::printf("Written:   %.2f MiB\n", mib(a.total_written));
+        std::printf("Errors:    %" PRIu64 "\n", a.errors);
+    }
+
+
+    void
+    print_throughput(const analysis& a)
+    {
+        std::printf("\nThroughput (per %.3f s):\n", a.interval_us / 1e6);
+        std::uint64_t peak = 1;
+        for (auto& iv : a.intervals)
+            peak = std::max({peak, iv.read, iv.written});
+
+        const double seconds = a.interval_us / 1e6;
+        const int bar_width = 40;
+        std::printf("  %10s %10s %10s %8s\n",
+                    "time (s)", "rd MiB/s", "wr MiB/s", "req/s");
+        for (std::size_t i = 0; i < a.intervals.size(); ++i) {
+            const auto& iv = a.intervals[i];
+            const int bar = static_cast<int>(iv.read * bar_width / peak);
+            std::printf("  %10.3f %10.2f %10.2f %8.0f |%.*s\n",
+                        i * seconds,
+                        mib(iv.read) / seconds,
+                        mib(iv.written) / seconds,
+                        iv.requests / seconds,
+                        bar,
+                        "########################################");
+        }
+    }
+
+
+    void
+    print_latencies(analysis& a)
+    {
+        std::printf("\nLatency (ms):\n");
+        std::printf("  %-10s %8s %8s %8s %8s %8s\n",
+                    "command", "count", "p50", "p90", "p99", "max");
+        for (auto& [command, values] : a.latencies) {
+            std::sort(values.begin(), values.end());
+            auto pct = [&values](double p) -> double
+            {
+                const std::size_t i = static_cast<std::size_t>(p * (values.size() - 1));
+                return values[i] / 1000.0;
+            };
+            const char* name = command_name(command);
+            char unknown[16];
+            if (!name) {
+                std::snprintf(unknown, sizeof unknown, "0x%02x", command);
+                name = unknown;
+            }
+            std::printf("  %-10s %8zu %8.2f %8.2f %8.2f %8.2f\n",
+                        name,
+                        values.size(),
+                        pct(0.50),
+                        pct(0.90),
+                        pct(0.99),
+                        values.back() / 1000.0);
+        }
+    }
+
+
+    void
+    print_seeks(const analysis& a)
+    {
+        std::uint64_t total = 0;
+        std::uint64_t total_bytes = 0;
+        for (std::size_t i = 0; i < num_seek_buckets; ++i) {
+            total += a.seeks[i];
+            total_bytes += a.seek_bytes[i];
+        }
+
+        std::printf("\nSeek distance (file reads and writes):\n");
+        if (!total) {
+            std::printf("  (none)\n");
+            return;
+        }
+        for (std::size_t i = 0; i < num_seek_buckets; ++i)
+            std::printf("  %-10s %10" PRIu64 " %6.1f%%  %10.2f MiB\n",
+                        seek_labels[i],
+                        a.seeks[i],
+                        100.0 * a.seeks[i] / total,
+                        mib(a.seek_bytes[i]));
+        std::printf("  Sequential: %.1f%% of requests, %.1f%% of bytes\n",
+                    100.0 * a.seeks[0] / total,
+                    total_bytes ? 100.0 * a.seek_bytes[0] / total_bytes : 0.0);
+        std::printf("  Backward:   %" PRIu64 "\n", a.backward_seeks);
+        if (a.unknown_pos)
+            std::printf("  Unknown:    %" PRIu64 " (opened before the trace started)\n",
+                        a.unknown_pos);
+    }
+
+
+    void
+    print_top_files(const analysis& a,
+                    std::size_t n)
+    {
+        std::vector<std::pair<std::string, std::uint64_t>> top{a.bytes_per_path.begin(),
+                                                               a.bytes_per_path.end()};
+        n = std::min(n, top.size());
+        std::partial_sort(top.begin(), top.begin() + n, top.end(),
+                          [](const auto& x, const auto& y)
+                          {
+                              return x.second > y.second;
+                          });
+
+        std::printf("\nMost read files:\n");
+        if (!n)
+            std::printf("  (none)\n");
+        for (std::size_t i = 0; i < n; ++i)
+            std::printf("  %10.2f MiB  %s\n", mib(top[i].second), top[i].first.c_str());
+    }
+
+
+    void
+    usage(const char* argv0)
+    {
+        std::fprintf(stderr,
+                     "Usage: %s [--interval MS] [--top N] FILE.iotrace\n",
+                     argv0);
+    }
+
+} // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    std::uint64_t interval_ms = 1000;
+    std::size_t top_n = 10;
+    const char* filename = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--interval" && i + 1 < argc)
+            interval_ms = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--top" && i + 1 < argc)
+            top_n = std::strtoull(argv[++i], nullptr, 10);
+        else if (!filename && !arg.starts_with("-"))
+            filename = argv[i];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!filename || !interval_ms) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        std::perror(filename);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        std::perror(filename);
+        return 1;
+    }
+    const std::size_t size = st.st_size;
+    if (size < io_trace::header_size) {
+        std::fprintf(stderr, "%s: not an I/O trace\n", filename);
+        return 1;
+    }
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        std::perror(filename);
+        return 1;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const auto* data = static_cast<const std::uint8_t*>(map);
+    const auto* end = data + size;
+
+    analysis a{interval_ms};
+    if (!io_trace::decode_header(data, size, a.header)) {
+        std::fprintf(stderr, "%s: not an I/O trace, or an unknown version\n", filename);
+        return 1;
+    }
+    a.end_time = a.header.start_time;
+
+    const std::uint8_t* in = data + io_trace::header_size;
+    std::uint64_t prev_time = a.header.start_time;
+    record r;
+    while (in != end) {
+        if (!io_trace::decode_record(in, end, r, prev_time)) {
+            a.truncated = true;
+            break;
+        }
+        if (r.command == io_trace::cmd_end) {
+            a.end_time = r.time;
+            a.dropped = r.count;
+            a.complete = true;
+            break;
+        }
+        if (!a.add(r)) {
+            a.out_of_range = true;
+            break;
+        }
+    }
+
+    print_summary(a);
+    print_throughput(a);
+    print_latencies(a);
+    print_seeks(a);
+    print_top_files(a, top_n);
+
+    munmap(map, size);
+}
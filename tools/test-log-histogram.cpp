@@ -0,0 +1,242 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Log histogram test and benchmark
+ *
+ * Compares the quantiles from log_histogram against an exact sort, for a few frame time
+ * distributions, and over a sliding window (like gx2_mon::fps uses it); every estimate
+ * must be within 1/32 of the exact value. Also checks that atomic_log_histogram doesn't
+ * lose samples added from several threads.
+ *
+ * Then measures the cost of adding a sample and computing the 1% and 0.1% lows, against
+ * sorting a copy of the window.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "log_histogram.hpp"
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    const float quantiles[] = {0.001f, 0.01f, 0.1f, 0.5f, 0.9f, 0.99f, 0.999f, 1.0f};
+
+    // Relative error allowed: half a bucket, plus some float rounding.
+    const double tolerance = 1.0 / 32 + 1e-6;
+
+    unsigned failures = 0;
+
+
+    std::uint32_t
+    exact_quantile(std::vector<std::uint32_t>& sorted, float q)
+    {
+        auto rank = static_cast<std::size_t>(std::ceil(q * sorted.size()));
+        rank = std::max<std::size_t>(rank, 1);
+        return sorted[rank - 1];
+    }
+
+
+    double
+    check(const char* name,
+          const utils::log_histogram& h,
+          std::vector<std::uint32_t> samples)
+    {
+        std::sort(samples.begin(), samples.end());
+        double worst = 0;
+        for (float q : quantiles) {
+            const double exact = exact_quantile(samples, q);
+            const double estimate = h.quantile(q);
+            const double err = exact ? std::abs(estimate - exact) / exact : estimate;
+            worst = std::max(worst, err);
+            if (err > tolerance) {
+                std::printf("FAIL: %s: q=%.3f exact=%.0f estimate=%.1f\n",
+                            name, q, exact, estimate);
+                ++failures;
+            }
+        }
+        return worst;
+    }
+
+
+    // Frame times in microseconds.
+    template<typename Gen>
+    std::vector<std::uint32_t>
+    make_samples(Gen&& gen, std::size_t n)
+    {
+        std::vector<std::uint32_t> v(n);
+        for (auto& x : v)
+            x = gen();
+        return v;
+    }
+
+
+    void
+    test_accuracy()
+    {
+        std::mt19937 rng{42};
+        const std::size_t n = 100000;
+
+        struct dist {
+            const char* name;
+            std::vector<std::uint32_t> samples;
+        };
+        std::uniform_int_distribution<std::uint32_t> uniform{0, 100000};
+        std::lognormal_distribution<double> lognormal{std::log(16667.0), 0.1};
+        std::uniform_real_distribution<double> coin{0, 1};
+        dist dists[] = {
+            {"uniform", make_samples([&] { return uniform(rng); }, n)},
+            {"lognormal", make_samples([&] { return std::lround(lognormal(rng)); }, n)},
+            {"60 fps + hitches", make_samples([&]
+            {
+                if (coin(rng) < 0.005)
+                    return 100000u + uniform(rng);
+                return 16667u + uniform(rng) % 200;
+            }, n)},
+            {"all values < 64", make_samples([&] { return uniform(rng) % 64; }, n)},
+        };
+
+        for (auto& d : dists) {
+            utils::log_histogram h;
+            for (auto x : d.samples)
+                h.add(x);
+            const double worst = check(d.name, h, d.samples);
+            std::printf("  %-20s worst error %.2f%%\n", d.name, 100 * worst);
+        }
+
+        // Sliding window, like fps keeps: add the new sample, remove the oldest.
+        const std::size_t window = 2048;
+        auto& samples = dists[2].samples;
+        utils::log_histogram h;
+        double worst = 0;
+        for (std::size_t i = 0; i < samples.size(); ++i) {
+            h.add(samples[i]);
+            if (i >= window)
+                h.remove(samples[i - window]);
+            if (i % 9973 == 0 && i >= window) {
+                std::vector<std::uint32_t> win(samples.begin() + (i + 1 - window),
+                                               samples.begin() + (i + 1));
+                worst = std::max(worst, check("sliding window", h, win));
+            }
+        }
+        std::printf("  %-20s worst error %.2f%%\n", "sliding window", 100 * worst);
+    }
+
+
+    void
+    test_atomic()
+    {
+        const unsigned num_threads = 4;
+        const unsigned per_thread = 250000;
+
+        utils::atomic_log_histogram ah;
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < num_threads; ++t)
+            threads.emplace_back([&ah, t]
+            {
+                for (unsigned i = 0; i < per_thread; ++i)
+                    ah.add((i * 2654435761u + t) % 1000000);
+            });
+        for (auto& t : threads)
+            t.join();
+
+        utils::log_histogram h;
+        ah.take(h);
+        if (h.count != num_threads * per_thread) {
+            std::printf("FAIL: atomic histogram has %u samples, expected %u\n",
+                        h.count, num_threads * per_thread);
+            ++failures;
+        }
+        utils::log_histogram empty;
+        ah.take(empty);
+        if (empty.count) {
+            std::printf("FAIL: take() didn't empty the atomic histogram\n");
+            ++failures;
+        }
+    }
+
+
+    template<typename F>
+    double
+    time_ns(F&& f, unsigned reps)
+    {
+        const auto start = clock_type::now();
+        for (unsigned i = 0; i < reps; ++i)
+            f();
+        const auto stop = clock_type::now();
+        return std::chrono::duration<double, std::nano>(stop - start).count() / reps;
+    }
+
+
+    void
+    benchmark()
+    {
+        std::mt19937 rng{7};
+        std::lognormal_distribution<double> lognormal{std::log(16667.0), 0.2};
+        const std::size_t window = 2048;
+        std::vector<std::uint32_t> samples(1 << 20);
+        for (auto& x : samples)
+            x = std::lround(lognormal(rng));
+
+        utils::log_histogram h;
+        std::size_t i = 0;
+        const double add_ns = time_ns([&]
+        {
+            h.add(samples[i % samples.size()]);
+            if (i >= window)
+                h.remove(samples[(i - window) % samples.size()]);
+            ++i;
+        }, samples.size());
+
+        volatile float sink = 0;
+        const double quantile_ns = time_ns([&]
+        {
+            sink = sink + h.quantile(0.99f) + h.quantile(0.999f);
+        }, 10000);
+
+        std::vector<std::uint32_t> copy;
+        const double sort_ns = time_ns([&]
+        {
+            copy.assign(samples.begin(), samples.begin() + window);
+            std::sort(copy.begin(), copy.end());
+            sink = sink + copy[window * 99 / 100] + copy[window * 999 / 1000];
+        }, 1000);
+
+        std::printf("  add + remove:        %8.1f ns/sample\n", add_ns);
+        std::printf("  1%% and 0.1%% lows:    %8.1f ns (histogram)\n", quantile_ns);
+        std::printf("  1%% and 0.1%% lows:    %8.1f ns (sorting %zu samples)\n",
+                    sort_ns, window);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    std::printf("Accuracy:\n");
+    test_accuracy();
+    test_atomic();
+    std::printf("Throughput:\n");
+    benchmark();
+
+    if (failures) {
+        std::printf("%u failures\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+}
@@ -0,0 +1,191 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Object pool stress test
+ *
+ * Works like fs_mon's async wrappers: "submit" threads create objects (yielding when the
+ * pool is exhausted) and hand them over to "complete" threads, that check and destroy
+ * them; the submitters also destroy some objects right away, like a failed call does.
+ * The pool is kept small, so it's exhausted all the time, and slots get reused while
+ * other threads are in the middle of a pop.
+ *
+ * Every object carries a pattern derived from its id, so two live objects sharing a slot
+ * get caught. At the end, nothing may be in use, and every slot must be reachable again.
+ *
+ * Worth running under ThreadSanitizer too:
+ *
+ *     make -C tools test-object-pool CXXFLAGS="-O1 -g -fsanitize=thread"
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "object_pool.hpp"
+
+
+namespace {
+
+    const std::uint16_t capacity = 16;
+    const unsigned num_submitters = 3;
+    const unsigned num_completers = 2;
+    const unsigned per_submitter = 300000;
+
+
+    struct request {
+        std::uint64_t id;
+        std::uint64_t check;
+
+        explicit
+        request(std::uint64_t id) :
+            id{id},
+            check{~id * 0x9e3779b97f4a7c15ull}
+        {}
+
+        ~request()
+        {
+            id = check = 0;
+        }
+
+        bool
+        valid()
+            const
+        {
+            return id && check == ~id * 0x9e3779b97f4a7c15ull;
+        }
+    };
+
+
+    utils::object_pool<request, capacity> pool;
+
+    std::mutex queue_mutex;
+    std::deque<request*> queue;
+    std::atomic_uint submitters_done = 0;
+
+    std::atomic_uint64_t created = 0;
+    std::atomic_uint64_t destroyed = 0;
+    std::atomic_uint64_t yields = 0;
+    std::atomic_uint corrupted = 0;
+
+
+    void
+    check_and_destroy(request* r, std::uint64_t id)
+    {
+        if (!r->valid() || (id && r->id != id))
+            ++corrupted;
+        pool.destroy(r);
+        ++destroyed;
+    }
+
+
+    void
+    submit_main(unsigned t)
+    {
+        for (unsigned i = 0; i < per_submitter; ++i) {
+            const std::uint64_t id = (std::uint64_t{t + 1} << 32) | (i + 1);
+            request* r;
+            while (!(r = pool.create(id))) {
+                ++yields;
+                std::this_thread::yield();
+            }
+            ++created;
+
+            // One in four "fails" right away, and is destroyed by the submitter.
+            if (i % 4 == 0) {
+                check_and_destroy(r, id);
+                continue;
+            }
+            std::lock_guard lock{queue_mutex};
+            queue.push_back(r);
+        }
+        ++submitters_done;
+    }
+
+
+    void
+    complete_main()
+    {
+        for (;;) {
+            request* r = nullptr;
+            {
+                std::lock_guard lock{queue_mutex};
+                if (!queue.empty()) {
+                    r = queue.front();
+                    queue.pop_front();
+                }
+            }
+            if (r) {
+                check_and_destroy(r, 0);
+                continue;
+            }
+            if (submitters_done == num_submitters) {
+                std::lock_guard lock{queue_mutex};
+                if (queue.empty())
+                    return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_submitters; ++t)
+        threads.emplace_back(submit_main, t);
+    for (unsigned t = 0; t < num_completers; ++t)
+        threads.emplace_back(complete_main);
+    for (auto& t : threads)
+        t.join();
+
+    unsigned failures = 0;
+    auto expect = [&failures](bool ok, const char* what)
+    {
+        if (!ok) {
+            std::printf("FAIL: %s\n", what);
+            ++failures;
+        }
+    };
+
+    std::printf("created %llu, destroyed %llu, %llu yields, peak %u/%u, %u exhausted\n",
+                static_cast<unsigned long long>(created.load()),
+                static_cast<unsigned long long>(destroyed.load()),
+                static_cast<unsigned long long>(yields.load()),
+                static_cast<unsigned>(pool.peak.load()),
+                unsigned{capacity},
+                static_cast<unsigned>(pool.exhausted.load()));
+
+    expect(created == std::uint64_t{num_submitters} * per_submitter, "created count");
+    expect(created == destroyed, "everything destroyed");
+    expect(!corrupted, "objects corrupted by a shared slot");
+    expect(pool.in_use == 0, "in_use back to zero");
+    expect(pool.peak <= capacity, "peak within capacity");
+    expect(pool.exhausted == yields, "exhausted counts every failed create()");
+
+    // Every slot must be free, exactly once.
+    std::vector<request*> all;
+    while (request* r = pool.create(1))
+        all.push_back(r);
+    expect(all.size() == capacity, "every slot reachable after the stress");
+    for (auto r : all)
+        pool.destroy(r);
+
+    if (failures) {
+        std::printf("%u failures\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+}
@@ -0,0 +1,174 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Pointer map test and benchmark
+ *
+ * Runs random inserts, finds and erases on a ptr_map and on a std::unordered_map, and
+ * checks that they always agree; the keys are aligned like real handles, and clustered,
+ * so erasing has to shift long probe sequences back. Also checks that inserting fails
+ * only when the map is at max_size.
+ *
+ * Then measures the cost of an insert + find + erase, against std::unordered_map.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "ptr_map.hpp"
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    const std::size_t capacity = 256;
+    using map_type = utils::ptr_map<unsigned, capacity>;
+
+    unsigned failures = 0;
+
+
+    void
+    expect(bool ok, const char* what, unsigned step)
+    {
+        if (!ok && failures++ < 10)
+            std::printf("FAIL: %s, at step %u\n", what, step);
+    }
+
+
+    const void*
+    to_ptr(std::uintptr_t x)
+    {
+        return reinterpret_cast<const void*>(x);
+    }
+
+
+    void
+    test_random()
+    {
+        std::mt19937 rng{42};
+        // 1.5 times the capacity, so the map fills up often.
+        std::uniform_int_distribution<std::uintptr_t> slot{1, capacity * 3 / 2};
+        std::uniform_int_distribution<unsigned> op{0, 2};
+
+        map_type map;
+        std::unordered_map<const void*, unsigned> ref;
+        for (unsigned step = 0; step < 2000000; ++step) {
+            const void* key = to_ptr(0x10000000 + 64 * slot(rng));
+            switch (op(rng)) {
+                case 0: {
+                    const bool inserted = map.insert(key, step);
+                    const bool present = ref.contains(key);
+                    expect(inserted == (present || ref.size() < map_type::max_size),
+                           "insert() result", step);
+                    if (inserted)
+                        ref[key] = step;
+                    break;
+                }
+                case 1: {
+                    auto found = map.find(key);
+                    auto it = ref.find(key);
+                    expect(!found == (it == ref.end()), "find() presence", step);
+                    if (found && it != ref.end())
+                        expect(*found == it->second, "find() value", step);
+                    break;
+                }
+                case 2: {
+                    auto erased = map.erase(key);
+                    auto it = ref.find(key);
+                    expect(!erased == (it == ref.end()), "erase() presence", step);
+                    if (erased && it != ref.end()) {
+                        expect(*erased == it->second, "erase() value", step);
+                        ref.erase(it);
+                    }
+                    break;
+                }
+            }
+            expect(map.size == ref.size(), "size", step);
+        }
+
+        // Everything left must still be reachable.
+        for (auto [key, value] : ref) {
+            auto found = map.find(key);
+            expect(found && *found == value, "final find()", 0);
+        }
+
+        expect(!map.insert(nullptr, 1), "insert(nullptr)", 0);
+        expect(!map.find(nullptr), "find(nullptr)", 0);
+        map.clear();
+        expect(map.size == 0 && !map.find(ref.begin()->first), "clear()", 0);
+    }
+
+
+    template<typename F>
+    double
+    time_ns(F&& f, unsigned reps)
+    {
+        const auto start = clock_type::now();
+        for (unsigned i = 0; i < reps; ++i)
+            f(i);
+        const auto stop = clock_type::now();
+        return std::chrono::duration<double, std::nano>(stop - start).count() / reps;
+    }
+
+
+    void
+    benchmark()
+    {
+        // Keep the map half full, like the file handle table in a busy game.
+        std::vector<const void*> keys(capacity / 2 * 3);
+        std::mt19937 rng{7};
+        for (auto& k : keys)
+            k = to_ptr(0x10000000 + 64 * (rng() & 0xffff));
+        const unsigned reps = 4000000;
+        const std::size_t live = capacity / 2;
+
+        volatile unsigned sink = 0;
+        map_type map;
+        const double map_ns = time_ns([&](unsigned i)
+        {
+            map.insert(keys[(i + live) % keys.size()], i);
+            if (auto v = map.find(keys[(i + live / 2) % keys.size()]))
+                sink = sink + *v;
+            map.erase(keys[i % keys.size()]);
+        }, reps);
+
+        std::unordered_map<const void*, unsigned> ref;
+        const double ref_ns = time_ns([&](unsigned i)
+        {
+            ref[keys[(i + live) % keys.size()]] = i;
+            if (auto it = ref.find(keys[(i + live / 2) % keys.size()]); it != ref.end())
+                sink = sink + it->second;
+            ref.erase(keys[i % keys.size()]);
+        }, reps);
+
+        std::printf("  ptr_map:             %8.1f ns/op\n", map_ns);
+        std::printf("  std::unordered_map:  %8.1f ns/op\n", ref_ns);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    std::printf("Random operations:\n");
+    test_random();
+    std::printf("Insert + find + erase:\n");
+    benchmark();
+
+    if (failures) {
+        std::printf("%u failures\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+}
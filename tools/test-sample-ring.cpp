@@ -0,0 +1,251 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Sample ring test and benchmark
+ *
+ * Checks running_stats against a two-pass mean and variance, over GPU utilization-like
+ * samples, and checks that sample_ring keeps exactly the last N samples.
+ *
+ * spsc_sample_ring is fed a counting sequence by a producer thread that keeps lapping
+ * the consumer: every sample the consumer gets must be one it hasn't seen yet, and not
+ * newer than the head it drained up to, and samples received plus dropped must add up
+ * to samples pushed.
+ *
+ * Then measures the cost of a push(), and of a take() once per report, against pushing
+ * into a std::vector and averaging it, like gx2_mon used to do.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "sample_ring.hpp"
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    unsigned failures = 0;
+
+
+    void
+    expect(bool ok, const char* what)
+    {
+        if (!ok && failures++ < 10)
+            std::printf("FAIL: %s\n", what);
+    }
+
+
+    bool
+    close(double a, double b, double rel)
+    {
+        return std::abs(a - b) <= rel * std::max(std::abs(b), 1.0);
+    }
+
+
+    void
+    test_stats()
+    {
+        std::mt19937 rng{42};
+        std::normal_distribution<float> busy{70, 15};
+
+        for (unsigned n : {1u, 2u, 60u, 1000u, 100000u}) {
+            std::vector<float> samples(n);
+            for (auto& x : samples)
+                x = std::clamp(busy(rng), 0.0f, 100.0f);
+
+            utils::running_stats stats;
+            for (float x : samples)
+                stats.add(x);
+
+            const double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+            double m2 = 0;
+            for (float x : samples)
+                m2 += (x - mean) * (x - mean);
+            const double var = n < 2 ? 0 : m2 / (n - 1);
+
+            expect(stats.count == n, "count");
+            expect(close(stats.mean, mean, 1e-4), "mean");
+            expect(close(stats.variance(), var, 1e-3), "variance");
+            expect(stats.min == *std::ranges::min_element(samples), "min");
+            expect(stats.max == *std::ranges::max_element(samples), "max");
+            expect(stats.last == samples.back(), "last");
+            std::printf("  n=%-6u mean %.4f (exact %.4f), stddev %.4f (exact %.4f)\n",
+                        n, stats.mean, mean, stats.stddev(), std::sqrt(var));
+
+            const auto taken = stats.take();
+            expect(taken.count == n && stats.count == 0, "take() clears");
+        }
+    }
+
+
+    void
+    test_ring()
+    {
+        const std::size_t size = 8;
+        utils::sample_ring<unsigned, size> ring;
+        expect(ring.view().empty() && !ring.full(), "starts empty");
+
+        for (unsigned i = 1; i <= 20; ++i) {
+            if (ring.full())
+                expect(ring.oldest() == i - size, "oldest() is the one overwritten");
+            ring.push(i);
+
+            std::vector<unsigned> kept(ring.view().begin(), ring.view().end());
+            std::ranges::sort(kept);
+            const unsigned first = i > size ? i - size + 1 : 1;
+            bool ok = kept.size() == std::min<std::size_t>(i, size);
+            for (std::size_t k = 0; ok && k < kept.size(); ++k)
+                ok = kept[k] == first + k;
+            expect(ok, "view() holds the last N samples");
+        }
+        expect(ring.full(), "full()");
+        expect(ring.take().count == 20, "take() counts every push");
+        expect(ring.full(), "take() keeps the samples");
+        ring.clear();
+        expect(ring.view().empty(), "clear()");
+    }
+
+
+    void
+    test_spsc()
+    {
+        const std::size_t size = 16;
+        utils::spsc_sample_ring<std::uint32_t, size> ring;
+
+        for (std::uint32_t i = 1; i <= 5; ++i)
+            ring.push(i);
+        expect(ring.drain() == 5, "spsc: drains what was pushed");
+        auto st = ring.take();
+        expect(st.count == 5 && st.min == 1 && st.max == 5, "spsc: samples kept");
+
+        // Lapped: only the newest samples survive, minus the one the producer could be
+        // overwriting.
+        for (std::uint32_t i = 1; i <= 3 * size; ++i)
+            ring.push(i);
+        st = ring.take();
+        expect(st.count + ring.dropped == 3 * size, "spsc: lapped samples dropped");
+        expect(st.count == size - 1 && st.max == 3 * size, "spsc: newest samples kept");
+        ring.clear();
+        expect(ring.take().count == 0 && ring.dropped == 0, "spsc: clear()");
+
+        // Against a producer thread. The values fit in a float exactly.
+        const std::uint32_t total = 1u << 20;
+        std::thread producer{[&ring] {
+            for (std::uint32_t i = 1; i <= total; ++i) {
+                ring.push(i);
+                if (i % 16 == 0)
+                    std::this_thread::yield();
+            }
+        }};
+
+        std::uint64_t received = 0;
+        std::uint32_t seen = 0;
+        unsigned drains = 0;
+        bool in_order = true;
+        while (received + ring.dropped < total) {
+            st = ring.take();
+            ++drains;
+            received += st.count;
+            if (st.count) {
+                in_order = in_order && st.min > seen && st.max <= ring.tail;
+                seen = st.max;
+            }
+            std::this_thread::yield();
+        }
+        producer.join();
+        st = ring.take();
+        received += st.count;
+
+        expect(in_order, "spsc: no stale or overwritten samples");
+        expect(received + ring.dropped == total, "spsc: received + dropped == pushed");
+        std::printf("  spsc: %llu received, %u dropped, in %u drains\n",
+                    static_cast<unsigned long long>(received), ring.dropped, drains);
+    }
+
+
+    void
+    benchmark()
+    {
+        // About one report per second, at 60 fps.
+        const unsigned per_report = 60;
+        const unsigned reports = 200000;
+
+        std::mt19937 rng{7};
+        std::vector<float> samples(4096);
+        for (auto& x : samples)
+            x = rng() % 10000 / 100.0f;
+
+        volatile float sink = 0;
+
+        utils::sample_ring<float, 128> ring;
+        auto start = clock_type::now();
+        for (unsigned r = 0; r < reports; ++r) {
+            for (unsigned i = 0; i < per_report; ++i)
+                ring.push(samples[(r * per_report + i) % samples.size()]);
+            sink = sink + ring.take().mean;
+        }
+        auto stop = clock_type::now();
+        const double ring_ns = std::chrono::duration<double, std::nano>(stop - start)
+            .count() / (reports * per_report);
+
+        std::vector<float> vec;
+        start = clock_type::now();
+        for (unsigned r = 0; r < reports; ++r) {
+            for (unsigned i = 0; i < per_report; ++i)
+                vec.push_back(samples[(r * per_report + i) % samples.size()]);
+            sink = sink + std::accumulate(vec.begin(), vec.end(), 0.0f) / vec.size();
+            vec.clear();
+        }
+        stop = clock_type::now();
+        const double vec_ns = std::chrono::duration<double, std::nano>(stop - start)
+            .count() / (reports * per_report);
+
+        utils::spsc_sample_ring<float, 128> spsc;
+        start = clock_type::now();
+        for (unsigned r = 0; r < reports; ++r) {
+            for (unsigned i = 0; i < per_report; ++i)
+                spsc.push(samples[(r * per_report + i) % samples.size()]);
+            sink = sink + spsc.take().mean;
+        }
+        stop = clock_type::now();
+        const double spsc_ns = std::chrono::duration<double, std::nano>(stop - start)
+            .count() / (reports * per_report);
+
+        std::printf("  sample_ring push + take:   %6.2f ns/sample\n", ring_ns);
+        std::printf("  spsc ring push + take:     %6.2f ns/sample\n", spsc_ns);
+        std::printf("  std::vector push + mean:   %6.2f ns/sample\n", vec_ns);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    std::printf("Statistics:\n");
+    test_stats();
+    test_ring();
+    test_spsc();
+    std::printf("Push and aggregate:\n");
+    benchmark();
+
+    if (failures) {
+        std::printf("%u failures\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+}
@@ -0,0 +1,157 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Sharded counter test and benchmark
+ *
+ * Three threads, one per shard like the Wii U's cores, add to a sharded_counter while a
+ * reader keeps calling take(); everything taken, plus what's left, must add up to what
+ * was added.
+ *
+ * Then measures the cost of an add with every thread hammering the counter, against a
+ * single shared atomic. The host's cache lines are usually 64 bytes, so the benchmark
+ * shows both the 32-byte shards the plugin uses, and 64-byte ones.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "sharded_counter.hpp"
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    const unsigned num_threads = 3;
+
+    unsigned failures = 0;
+
+
+    void
+    test_totals()
+    {
+        const unsigned per_thread = 2000000;
+
+        utils::sharded_counter<num_threads> counter;
+        std::atomic_bool done = false;
+        std::uint64_t taken = 0;
+        unsigned takes = 0;
+
+        std::thread reader{[&]
+        {
+            while (!done) {
+                taken += counter.take();
+                ++takes;
+            }
+        }};
+
+        std::vector<std::thread> writers;
+        for (unsigned t = 0; t < num_threads; ++t)
+            writers.emplace_back([&counter, t]
+            {
+                for (unsigned i = 0; i < per_thread; ++i)
+                    counter.add(t, 1 + i % 4);
+            });
+        for (auto& w : writers)
+            w.join();
+        done = true;
+        reader.join();
+        taken += counter.take();
+
+        // 1 + 2 + 3 + 4, every 4 adds.
+        const std::uint64_t expected = std::uint64_t{num_threads} * per_thread / 4 * 10;
+        std::printf("  %u takes while adding, total %llu\n",
+                    takes, static_cast<unsigned long long>(taken));
+        if (taken != expected) {
+            std::printf("FAIL: total is %llu, expected %llu\n",
+                        static_cast<unsigned long long>(taken),
+                        static_cast<unsigned long long>(expected));
+            ++failures;
+        }
+        if (counter.peek()) {
+            std::printf("FAIL: take() didn't empty the counter\n");
+            ++failures;
+        }
+    }
+
+
+    template<typename Add>
+    double
+    time_ns(Add&& add)
+    {
+        const unsigned per_thread = 10000000;
+
+        std::atomic_uint ready = 0;
+        std::vector<std::thread> threads;
+        const auto start = clock_type::now();
+        for (unsigned t = 0; t < num_threads; ++t)
+            threads.emplace_back([&, t]
+            {
+                ++ready;
+                while (ready < num_threads)
+                    std::this_thread::yield();
+                for (unsigned i = 0; i < per_thread; ++i)
+                    add(t);
+            });
+        for (auto& t : threads)
+            t.join();
+        const auto stop = clock_type::now();
+        const std::chrono::duration<double, std::nano> elapsed = stop - start;
+        return elapsed.count() / per_thread;
+    }
+
+
+    void
+    benchmark()
+    {
+        std::atomic_uint32_t single = 0;
+        const double single_ns = time_ns([&](unsigned)
+        {
+            single.fetch_add(1, std::memory_order_relaxed);
+        });
+
+        utils::sharded_counter<num_threads, 32> sharded32;
+        const double sharded32_ns = time_ns([&](unsigned t) { sharded32.add(t, 1); });
+
+        utils::sharded_counter<num_threads, 64> sharded64;
+        const double sharded64_ns = time_ns([&](unsigned t) { sharded64.add(t, 1); });
+
+        if (single != sharded32.peek() || single != sharded64.peek()) {
+            std::printf("FAIL: benchmark totals differ\n");
+            ++failures;
+        }
+
+        std::printf("  single atomic:        %6.2f ns/add\n", single_ns);
+        std::printf("  32-byte shards:       %6.2f ns/add\n", sharded32_ns);
+        std::printf("  64-byte shards:       %6.2f ns/add\n", sharded64_ns);
+        if (std::thread::hardware_concurrency() < num_threads)
+            std::printf("  (fewer cores than threads, so they never really contend)\n");
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    std::printf("Totals:\n");
+    test_totals();
+    std::printf("Contention, %u threads:\n", num_threads);
+    benchmark();
+
+    if (failures) {
+        std::printf("%u failures\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+}
@@ -0,0 +1,224 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Size-class pool test and benchmark
+ *
+ * Uses a plain aligned block in place of mapped memory. Checks that every block is
+ * aligned to its class size, comes from the smallest class with a free block, never
+ * overlaps a live one, and that the usage and failure counters add up; then churns
+ * random allocations and frees, checking the blocks' contents survive.
+ *
+ * Then measures the cost of an alloc + free, against malloc().
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "size_class_pool.hpp"
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+    using pool_type = utils::size_class_pool;
+
+    const std::size_t memory_size = 65536;
+
+    unsigned failures = 0;
+
+
+    void
+    expect(bool ok, const char* what)
+    {
+        if (!ok && failures++ < 10)
+            std::printf("FAIL: %s\n", what);
+    }
+
+
+    std::size_t
+    class_of(const pool_type& pool, const void* ptr)
+    {
+        auto* p = static_cast<const std::byte*>(ptr);
+        for (std::size_t c = 0; c < pool.classes.size(); ++c)
+            if (p >= pool.classes[c].begin && p < pool.classes[c].end)
+                return c;
+        return pool.classes.size();
+    }
+
+
+    void
+    test_classes(void* memory)
+    {
+        pool_type pool;
+        pool.init(memory, memory_size);
+
+        auto* mem = static_cast<std::byte*>(memory);
+        for (auto& sc : pool.classes) {
+            expect(sc.num_blocks > 0, "every class has blocks");
+            expect(sc.begin >= mem && sc.end <= mem + memory_size, "class inside memory");
+        }
+
+        // Exhaust the smallest class, then it must spill into the next one.
+        const auto& first = pool.classes[0];
+        std::vector<void*> blocks;
+        for (std::uint32_t i = 0; i < first.num_blocks; ++i) {
+            void* p = pool.alloc(1);
+            expect(p && class_of(pool, p) == 0, "small request uses the smallest class");
+            blocks.push_back(p);
+        }
+        expect(first.used == first.num_blocks && first.peak == first.num_blocks,
+               "used and peak count");
+        void* spilled = pool.alloc(1);
+        expect(class_of(pool, spilled) == 1, "full class spills into the next one");
+
+        for (void* p : blocks)
+            expect(pool.free(p), "free() own block");
+        expect(first.used == 0 && first.peak == first.num_blocks, "free() keeps peak");
+        expect(pool.alloc(1) && class_of(pool, pool.alloc(1)) == 0,
+               "freed blocks are reused");
+
+        // Exhaust the largest class.
+        const auto last = pool.classes.size() - 1;
+        const auto& big = pool.classes[last];
+        while (big.used < big.num_blocks)
+            pool.alloc(pool_type::max_block_size);
+        expect(!pool.alloc(pool_type::max_block_size), "exhausted class returns null");
+        expect(big.failures == 1, "failure counted in the best-fit class");
+        expect(!pool.alloc(pool_type::max_block_size + 1), "oversize returns null");
+        expect(pool.oversize_failures == 1, "oversize failure counted");
+
+        void* outside[4];
+        expect(!pool.free(outside), "free() foreign pointer");
+        expect(pool.free(nullptr), "free(nullptr)");
+    }
+
+
+    void
+    test_churn(void* memory)
+    {
+        pool_type pool;
+        pool.init(memory, memory_size);
+
+        struct live_block {
+            std::byte*    ptr;
+            std::uint32_t size;
+            unsigned char fill;
+        };
+        std::vector<live_block> live;
+        std::mt19937 rng{42};
+        std::uniform_int_distribution<std::uint32_t> size_dist{1,
+                                                               pool_type::max_block_size};
+
+        for (unsigned step = 0; step < 500000; ++step) {
+            if (live.empty() || rng() % 2) {
+                // Mostly small requests, like GX2PerfInit() makes.
+                std::uint32_t size = size_dist(rng) >> (rng() % 8);
+                size = std::max<std::uint32_t>(size, 1);
+                auto* p = static_cast<std::byte*>(pool.alloc(size));
+                if (!p)
+                    continue;
+                const std::size_t c = class_of(pool, p);
+                expect(c < pool.classes.size(), "block inside the pool");
+                expect(pool.classes[c].block_size >= size, "block large enough");
+                expect(reinterpret_cast<std::uintptr_t>(p)
+                       % pool.classes[c].block_size == 0, "block aligned");
+                const auto fill = static_cast<unsigned char>(step);
+                std::memset(p, fill, size);
+                live.push_back({p, size, fill});
+            } else {
+                const std::size_t i = rng() % live.size();
+                const auto b = live[i];
+                for (std::uint32_t k = 0; k < b.size; ++k)
+                    if (b.ptr[k] != std::byte{b.fill}) {
+                        expect(false, "block contents overwritten");
+                        break;
+                    }
+                expect(pool.free(b.ptr), "free() live block");
+                live[i] = live.back();
+                live.pop_back();
+            }
+
+            std::size_t used = 0;
+            for (auto& sc : pool.classes)
+                used += sc.used;
+            expect(used == live.size(), "used matches live blocks");
+        }
+
+        for (auto& b : live)
+            pool.free(b.ptr);
+        expect(pool.bytes_used() == 0, "everything freed");
+    }
+
+
+    void
+    benchmark(void* memory)
+    {
+        pool_type pool;
+        pool.init(memory, memory_size);
+        const unsigned reps = 10000000;
+        std::uint32_t sizes[16];
+        std::mt19937 rng{7};
+        for (auto& s : sizes)
+            s = 1 + rng() % 256;
+
+        std::vector<void*> held(8);
+        auto time_ns = [&](auto alloc, auto free)
+        {
+            const auto start = clock_type::now();
+            for (unsigned i = 0; i < reps; ++i) {
+                void*& slot = held[i % held.size()];
+                free(slot);
+                slot = alloc(sizes[i % 16]);
+            }
+            for (void*& p : held) {
+                free(p);
+                p = nullptr;
+            }
+            const auto stop = clock_type::now();
+            return std::chrono::duration<double, std::nano>(stop - start).count() / reps;
+        };
+
+        const double pool_ns = time_ns([&](std::size_t n) { return pool.alloc(n); },
+                                       [&](void* p) { pool.free(p); });
+        const double malloc_ns = time_ns([](std::size_t n) { return std::malloc(n); },
+                                         [](void* p) { std::free(p); });
+
+        std::printf("  size_class_pool:     %8.1f ns/op\n", pool_ns);
+        std::printf("  malloc():            %8.1f ns/op\n", malloc_ns);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    void* memory = std::aligned_alloc(pool_type::max_block_size, memory_size);
+
+    std::printf("Size classes:\n");
+    test_classes(memory);
+    std::printf("Random allocations:\n");
+    test_churn(memory);
+    std::printf("Alloc + free:\n");
+    benchmark(memory);
+
+    std::free(memory);
+
+    if (failures) {
+        std::printf("%u failures\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+}
@@ -0,0 +1,169 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Space-Saving test and benchmark
+ *
+ * Feeds skewed streams of (file, bytes read) into a 32-counter sketch, like fs_mon's hot
+ * files, and checks its guarantees against exact counts: every tracked key's true weight
+ * is between count - error and count, and every key with more than 1/K of the total is
+ * tracked.
+ *
+ * Then measures the cost of an add, against counting exactly with std::unordered_map;
+ * the sketch scans its counters, so it's slower, but its memory is bounded. fs_mon only
+ * adds to it when a core switches files, or on a report.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "space_saving.hpp"
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    const std::size_t k = 32;
+    using sketch_type = utils::space_saving<std::uint32_t, k>;
+
+    unsigned failures = 0;
+
+
+    void
+    expect(bool ok, const char* name, const char* what)
+    {
+        if (!ok && failures++ < 10)
+            std::printf("FAIL: %s: %s\n", name, what);
+    }
+
+
+    struct sample {
+        std::uint32_t key;
+        std::uint32_t weight;
+    };
+
+
+    // Keys drawn with a Zipf-like distribution, with read sizes from 4 KiB to 1 MiB.
+    std::vector<sample>
+    make_stream(unsigned num_keys, double skew, std::size_t n, unsigned seed)
+    {
+        std::vector<double> weights(num_keys);
+        for (unsigned i = 0; i < num_keys; ++i)
+            weights[i] = 1 / std::pow(i + 1, skew);
+        std::mt19937 rng{seed};
+        std::discrete_distribution<std::uint32_t> key_dist{weights.begin(),
+                                                           weights.end()};
+        std::uniform_int_distribution<unsigned> size_shift{12, 20};
+
+        std::vector<sample> stream(n);
+        for (auto& s : stream)
+            s = {1 + key_dist(rng), 1u << size_shift(rng)};
+        return stream;
+    }
+
+
+    void
+    check(const char* name, const std::vector<sample>& stream)
+    {
+        sketch_type sketch;
+        std::unordered_map<std::uint32_t, std::uint64_t> exact;
+        for (auto s : stream) {
+            sketch.add(s.key, s.weight);
+            exact[s.key] += s.weight;
+        }
+
+        std::uint64_t total = 0;
+        for (auto [key, weight] : exact)
+            total += weight;
+        expect(sketch.total == total, name, "total");
+
+        std::array<sketch_type::counter, k> top;
+        const std::size_t n = sketch.top(top);
+        expect(n == std::min(k, exact.size()), name, "top() size");
+        for (std::size_t i = 1; i < n; ++i)
+            expect(top[i - 1].count >= top[i].count, name, "top() order");
+
+        std::uint64_t worst_error = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const std::uint64_t truth = exact[top[i].key];
+            expect(truth <= top[i].count, name, "count underestimated");
+            expect(top[i].count - top[i].error <= truth, name, "error bound too small");
+            worst_error = std::max(worst_error, top[i].count - truth);
+        }
+
+        unsigned heavy = 0;
+        for (auto [key, weight] : exact) {
+            if (weight * k <= total)
+                continue;
+            ++heavy;
+            const bool tracked = std::any_of(top.begin(), top.begin() + n,
+                                             [key](auto& c) { return c.key == key; });
+            expect(tracked, name, "heavy hitter not tracked");
+        }
+
+        std::printf("  %-12s %zu keys, %u above 1/K, worst overestimate %.2f%%\n",
+                    name, exact.size(), heavy, 100.0 * worst_error / total);
+    }
+
+
+    void
+    benchmark()
+    {
+        const auto stream = make_stream(2000, 1.1, 1 << 20, 7);
+        volatile std::uint64_t sink = 0;
+
+        sketch_type sketch;
+        auto start = clock_type::now();
+        for (auto s : stream)
+            sketch.add(s.key, s.weight);
+        auto stop = clock_type::now();
+        sink = sink + sketch.total;
+        const double sketch_ns = std::chrono::duration<double, std::nano>(stop - start)
+            .count() / stream.size();
+
+        std::unordered_map<std::uint32_t, std::uint64_t> exact;
+        start = clock_type::now();
+        for (auto s : stream)
+            exact[s.key] += s.weight;
+        stop = clock_type::now();
+        sink = sink + exact.size();
+        const double exact_ns = std::chrono::duration<double, std::nano>(stop - start)
+            .count() / stream.size();
+
+        std::printf("  space_saving<%zu>:     %6.1f ns/add\n", k, sketch_ns);
+        std::printf("  std::unordered_map:   %6.1f ns/add (%zu keys)\n",
+                    exact_ns, exact.size());
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    std::printf("Error bounds:\n");
+    check("few keys", make_stream(20, 1.0, 100000, 1));
+    check("zipf 1.2", make_stream(5000, 1.2, 200000, 2));
+    check("zipf 0.8", make_stream(5000, 0.8, 200000, 3));
+    check("uniform", make_stream(5000, 0.0, 200000, 4));
+    std::printf("Throughput:\n");
+    benchmark();
+
+    if (failures) {
+        std::printf("%u failures\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+}
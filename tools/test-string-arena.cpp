@@ -0,0 +1,143 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * String arena test and benchmark
+ *
+ * Interns file paths like a game's opens would (many distinct, most of them repeated),
+ * and checks that each gets a stable id that gives the same string back; then fills the
+ * arena, both by count and by size, and checks that interning fails cleanly.
+ *
+ * Then measures the cost of interning a path that's already there, which is the common
+ * case when a game keeps reopening the same files.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "string_arena.hpp"
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    unsigned failures = 0;
+
+
+    void
+    expect(bool ok, const char* what)
+    {
+        if (!ok && failures++ < 10)
+            std::printf("FAIL: %s\n", what);
+    }
+
+
+    std::string
+    make_path(unsigned i)
+    {
+        return "/vol/content/data/level" + std::to_string(i % 37)
+            + "/chunk_" + std::to_string(i) + ".bin";
+    }
+
+
+    void
+    test_intern()
+    {
+        // Same sizes as fs_mon's.
+        utils::string_arena<32 * 1024, 2048> arena;
+        std::unordered_map<std::string, std::uint32_t> ids;
+
+        for (unsigned round = 0; round < 3; ++round)
+            for (unsigned i = 0; i < 500; ++i) {
+                const std::string path = make_path(i);
+                const std::uint32_t id = arena.intern(path);
+                expect(id != 0, "intern() failed with room left");
+                auto [it, inserted] = ids.emplace(path, id);
+                expect(inserted || it->second == id, "same string, different id");
+                expect(arena.get(id) == path, "get() gives a different string");
+            }
+        expect(arena.num_strings == 500, "num_strings");
+        expect(arena.intern("") != 0 && arena.get(arena.intern("")) == std::string{},
+               "empty string");
+
+        // Fill by count.
+        utils::string_arena<1024 * 1024, 64> by_count;
+        unsigned accepted = 0;
+        for (unsigned i = 0; i < 100; ++i)
+            if (by_count.intern(make_path(i)))
+                ++accepted;
+        expect(accepted == by_count.max_strings, "fills up to max_strings");
+        expect(by_count.failures == 100 - accepted, "failures counted (by count)");
+        expect(by_count.intern(make_path(0)) != 0, "existing string found when full");
+
+        // Fill by size.
+        utils::string_arena<256, 64> by_size;
+        std::size_t bytes = 0;
+        for (unsigned i = 0; i < 20; ++i) {
+            const std::string path = make_path(i);
+            const std::uint32_t id = by_size.intern(path);
+            if (id) {
+                bytes += path.size() + 1;
+                expect(by_size.get(id) == path, "get() after filling");
+            }
+        }
+        expect(bytes <= 256 && by_size.used == bytes, "used bytes");
+        expect(by_size.failures > 0, "failures counted (by size)");
+
+        by_size.clear();
+        expect(by_size.used == 0 && by_size.num_strings == 0 && by_size.failures == 0,
+               "clear()");
+        expect(by_size.intern(make_path(0)) == 1, "first id after clear()");
+    }
+
+
+    void
+    benchmark()
+    {
+        utils::string_arena<32 * 1024, 2048> arena;
+        std::vector<std::string> paths;
+        for (unsigned i = 0; i < 400; ++i) {
+            paths.push_back(make_path(i));
+            arena.intern(paths.back());
+        }
+
+        const unsigned reps = 2000000;
+        volatile std::uint32_t sink = 0;
+        const auto start = clock_type::now();
+        for (unsigned i = 0; i < reps; ++i)
+            sink = sink + arena.intern(paths[i % paths.size()]);
+        const auto stop = clock_type::now();
+        const double ns = std::chrono::duration<double, std::nano>(stop - start).count()
+            / reps;
+
+        std::printf("  intern() hit:   %6.1f ns (%zu bytes per path)\n",
+                    ns, paths[0].size());
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    std::printf("Interning:\n");
+    test_intern();
+    std::printf("Throughput:\n");
+    benchmark();
+
+    if (failures) {
+        std::printf("%u failures\n", failures);
+        return 1;
+    }
+    std::printf("OK\n");
+}
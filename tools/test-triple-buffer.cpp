@@ -0,0 +1,167 @@
+/*
+ * Papaya-HUD - a HUD plugin for Aroma.
+ *
+ * Copyright (C) 2024  Daniel K. O.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Publisher test
+ *
+ * Runs the same protocol as the publisher in overlay.cpp: a "render" thread submits
+ * text into a triple buffer as fast as it can, while a "publisher" thread polls it, skips
+ * unchanged text, and calls a stubbed NotificationModule_UpdateDynamicNotificationText().
+ *
+ * Checks that the publisher never sees torn or out of order text, and measures how long
+ * a submit takes on the render thread, and how old the text is when it's published.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "triple_buffer.hpp"
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+
+    struct text_slot {
+        char text[512];
+        clock_type::time_point submitted;
+    };
+
+
+    utils::triple_buffer<text_slot> buffer;
+
+    std::atomic_bool done = false;
+
+    unsigned long long updates = 0;
+    unsigned long long last_seq = 0;
+    std::vector<double> publish_delays_us;
+
+
+    [[noreturn]]
+    void
+    fail(const char* msg, const char* text)
+    {
+        std::fprintf(stderr, "FAIL: %s: \"%.60s\"\n", msg, text);
+        std::exit(1);
+    }
+
+
+    // Stub: checks the text instead of showing it.
+    void
+    NotificationModule_UpdateDynamicNotificationText(const char* text,
+                                                     clock_type::time_point submitted)
+    {
+        ++updates;
+        const auto delay = clock_type::now() - submitted;
+        publish_delays_us.push_back(std::chrono::duration<double, std::micro>(delay)
+                                    .count());
+
+        // Every text is "<seq>:" followed by the same digit repeated.
+        char* end;
+        const unsigned long long seq = std::strtoull(text, &end, 10);
+        if (*end != ':')
+            fail("malformed text", text);
+        if (seq <= last_seq)
+            fail("text out of order", text);
+        last_seq = seq;
+        const char digit = '0' + seq % 10;
+        const std::size_t len = std::strlen(end + 1);
+        if (len != 100 + seq % 300)
+            fail("torn text (length)", text);
+        for (std::size_t i = 0; i < len; ++i)
+            if (end[1 + i] != digit)
+                fail("torn text (contents)", text);
+    }
+
+
+    void
+    publisher_main()
+    {
+        static char last_text[sizeof text_slot::text];
+        while (!done) {
+            // The real thread sleeps for 16 ms; poll faster, to stress the buffer.
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            const text_slot* slot = buffer.consume();
+            if (!slot)
+                continue;
+            if (!std::strcmp(slot->text, last_text))
+                continue;
+            std::strcpy(last_text, slot->text);
+            NotificationModule_UpdateDynamicNotificationText(last_text, slot->submitted);
+        }
+    }
+
+
+    double
+    percentile(std::vector<double>& v, double p)
+    {
+        std::sort(v.begin(), v.end());
+        return v[static_cast<std::size_t>(p * (v.size() - 1))];
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    const unsigned num_submits = 200000;
+
+    std::thread publisher{publisher_main};
+
+    std::vector<double> submit_ns;
+    submit_ns.reserve(num_submits);
+    std::string text;
+    for (unsigned long long seq = 1; seq <= num_submits; ++seq) {
+        text = std::to_string(seq) + ":";
+        text.append(100 + seq % 300, '0' + seq % 10);
+
+        const auto start = clock_type::now();
+        // Same as publisher::submit().
+        text_slot& slot = buffer.write_slot();
+        auto len = text.copy(slot.text, sizeof slot.text - 1);
+        slot.text[len] = '\0';
+        slot.submitted = start;
+        buffer.publish();
+        const auto stop = clock_type::now();
+        submit_ns.push_back(std::chrono::duration<double, std::nano>(stop - start)
+                            .count());
+    }
+
+    // Let the publisher see the last one.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    done = true;
+    publisher.join();
+
+    if (last_seq != num_submits) {
+        std::fprintf(stderr, "FAIL: last text published was %llu, not %u\n",
+                     last_seq, num_submits);
+        return 1;
+    }
+
+    std::printf("submits:        %u\n", num_submits);
+    std::printf("updates:        %llu (%.1f%% replaced before being published)\n",
+                updates, 100.0 * (num_submits - updates) / num_submits);
+    const double submit_p50 = percentile(submit_ns, 0.5);
+    const double submit_p99 = percentile(submit_ns, 0.99);
+    std::printf("submit time:    p50 %.0f ns, p99 %.0f ns, max %.0f ns\n",
+                submit_p50, submit_p99, submit_ns.back());
+    const double delay_p50 = percentile(publish_delays_us, 0.5);
+    const double delay_p99 = percentile(publish_delays_us, 0.99);
+    std::printf("publish delay:  p50 %.1f us, p99 %.1f us\n", delay_p50, delay_p99);
+    std::printf("OK\n");
+}